@@ -46,6 +46,28 @@ Matrix4x4 rotation( double angle, char axis )
 	return r;
 }
 
+// Return the same rotation as rotation( angle, axis ), as a quaternion.
+// Note that rotation() names its axes by the plane the rotation leaves
+// alone in the course notes' convention: 'x' turns about the z axis, 'y'
+// about the x axis and 'z' about the y axis.
+Quaternion rotation_quaternion( double angle, char axis )
+{
+	if ( axis == 'x' )
+	{
+		return Quaternion::axis_angle( Vector3D(0, 0, 1), angle );
+	}
+	else if ( axis == 'y' )
+	{
+		return Quaternion::axis_angle( Vector3D(1, 0, 0), angle );
+	}
+	else if ( axis == 'z' )
+	{
+		return Quaternion::axis_angle( Vector3D(0, 1, 0), angle );
+	}
+
+	return Quaternion();
+}
+
 // Return a matrix to represent a displacement of the given vector.
 Matrix4x4 translation( const Vector3D& displacement )
 {
@@ -81,3 +103,28 @@ Matrix4x4 scaling( const Vector3D& scale )
 
 	return s;
 }
+
+// Return a perspective projection matrix using the semantics of
+// gluPerspective(), with "fov" given in degrees.
+Matrix4x4 perspective( double fov, double aspect, double near, double far )
+{
+	Vector4D row1, row2, row3, row4;
+	double   rfov, x1, x2;
+
+	// Error check
+	if      ( fov < 5   ) fov = 5;
+	else if ( fov > 160 ) fov = 160;
+
+	// Calculate the fov in degrees related to the viewport
+	rfov = 1 / tan( fov * M_PI / 360 );
+	x1   = (      far + near ) / ( far - near );
+	x2   = ( -2 * far * near ) / ( far - near );
+
+	// Implement perspective matrix as described in course notes
+	row1 = Vector4D( rfov / aspect, 0,    0,  0  );
+	row2 = Vector4D( 0,             rfov, 0,  0  );
+	row3 = Vector4D( 0,             0,    x1, x2 );
+	row4 = Vector4D( 0,             0,    1,  0  );
+
+	return Matrix4x4( row1, row2, row3, row4 );
+}
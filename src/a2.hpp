@@ -2,6 +2,7 @@
 #define CS488_A2_HPP
 
 #include "algebra.hpp"
+#include "quaternion.hpp"
 
 
 // Return a matrix to represent a counterclockwise rotation of "angle"
@@ -9,10 +10,17 @@
 // characters 'x', 'y', or 'z'.
 Matrix4x4 rotation   ( double angle, char axis );
 
+// Return the same rotation as rotation( angle, axis ), as a quaternion.
+Quaternion rotation_quaternion( double angle, char axis );
+
 // Return a matrix to represent a displacement of the given vector.
 Matrix4x4 translation( const Vector3D& displacement );
 
 // Return a matrix to represent a nonuniform scale with the given factors.
 Matrix4x4 scaling    ( const Vector3D& scale );
 
+// Return a perspective projection matrix using the semantics of
+// gluPerspective(), with "fov" given in degrees.
+Matrix4x4 perspective( double fov, double aspect, double near, double far );
+
 #endif
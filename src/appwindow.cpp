@@ -2,7 +2,8 @@
 #include <iostream>
 
 
-AppWindow::AppWindow()
+AppWindow::AppWindow( int cubes, const char* record, const char* mesh,
+                      const char* scene )
 {
 	set_title("CS488 Assignment Two");
 
@@ -17,6 +18,10 @@ AppWindow::AppWindow()
 	// which shuts down the application.
 	m_menu_app.items().push_back( MenuElem("Reset", Gtk::AccelKey( "a" ),
 	sigc::mem_fun( m_viewer, &Viewer::reset_view )) );
+	m_menu_app.items().push_back( MenuElem("_Statistics", Gtk::AccelKey( "i" ),
+	sigc::mem_fun( m_viewer, &Viewer::toggle_stats )) );
+	m_menu_app.items().push_back( MenuElem("_Dump Statistics", Gtk::AccelKey( "d" ),
+	sigc::mem_fun( m_viewer, &Viewer::dump_stats )) );
 	m_menu_app.items().push_back( MenuElem("_Quit", Gtk::AccelKey( "q" ),
 	sigc::mem_fun( *this, &AppWindow::hide )) );
 
@@ -53,11 +58,24 @@ AppWindow::AppWindow()
 			Gtk::AccelKey( "v" ),
 			sigc::bind( mode_slot, Viewer::VIEWPORT )) );
 
+	// Set up the selection menu
+	m_menu_select.items().push_back( MenuElem("_All",
+			Gtk::AccelKey( "l" ),
+			sigc::mem_fun( m_viewer, &Viewer::select_all )) );
+	m_menu_select.items().push_back( MenuElem("_Next",
+			Gtk::AccelKey( "bracketright" ),
+			sigc::mem_fun( m_viewer, &Viewer::select_next )) );
+	m_menu_select.items().push_back( MenuElem("_Previous",
+			Gtk::AccelKey( "bracketleft" ),
+			sigc::mem_fun( m_viewer, &Viewer::select_previous )) );
+
 	// Set up the menu bar
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem
 		  ("_Application", m_menu_app));
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem
 		  ("_Mode", m_menu_mode));
+	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem
+		  ("_Select", m_menu_select));
 
 	// Pack in our widgets
 
@@ -85,6 +103,25 @@ AppWindow::AppWindow()
 
 	// Set the pointer to the window object so we can communicate back
 	m_viewer.set_window(this);
+
+	// Populate the scene
+	if ( cubes > 1 )
+	{
+		m_viewer.set_cubes( cubes );
+	}
+	if ( mesh )
+	{
+		m_viewer.open_mesh( mesh );
+	}
+	if ( scene )
+	{
+		m_viewer.open_scene( scene );
+	}
+
+	if ( record )
+	{
+		m_viewer.record( record );
+	}
 }
 
 void AppWindow::update_mode( int mode )
@@ -7,7 +7,11 @@
 
 class AppWindow : public Gtk::Window {
 public:
-	AppWindow();
+	// The scene holds "cubes" cubes, each drawn as the wireframe in "mesh"
+	// if one is given, or is the scene cache "scene" if that is. If
+	// "record" is given, the session is recorded into that file.
+	AppWindow( int cubes = 1, const char* record = NULL,
+	           const char* mesh = NULL, const char* scene = NULL );
 
 	// Updates the mode menu radio buttons
 	void update_mode   ( int mode         );
@@ -26,6 +30,7 @@ private:
 	// Each menu itself
 	Gtk::Menu    m_menu_app;
 	Gtk::Menu    m_menu_mode;
+	Gtk::Menu    m_menu_select;
 
 	// The information bar
 	Gtk::Label   m_infobar;
@@ -0,0 +1,498 @@
+// Headless benchmark of the Viewer's transform/clip/project pipeline.
+//
+// Drives the same render core the Viewer uses in on_expose_event (see
+// pipeline.hpp) without a display, sweeping the number of cubes in the
+// scene, the camera pose and the viewport size. For every configuration
+// it reports the per-frame cost in ns/edge (median, p90, p99 over all
+// frames), the throughput in edges/sec, and a checksum of the emitted
+// lines so that output can be diffed between builds.
+//
+// It first times the transform kernels on their own: the per-vertex
+// matrix products of algebra.hpp against the aligned kernels of simd.hpp.
+//
+// Frames are rendered on a pool of worker threads, one per hardware
+// thread unless -threads says otherwise; -threads 1 runs the serial path.
+// The sweep ends with the work-stealing statistics of each worker.
+//
+// With -raster, every frame is also drawn into a framebuffer by the
+// software rasterizer (draw_soft.cpp), and the checksum covers its pixels.
+//
+// With -check, it instead checks that movements queued in a MotionQueue
+// end up where the same movements applied one by one do, and exits with
+// status 1 if they don't.
+//
+// Usage: ./bench [-max cubes] [-frames n] [-threads n] [-raster] [-micro]
+//                [-check]
+
+#include "a2.hpp"
+#include "draw.hpp"
+#include "motion.hpp"
+#include "pipeline.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
+#include "transform.hpp"
+#include "scheduler.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+
+// Near and far planes and field of view, as set by Viewer::reset
+static const double s_near = 2.0;
+static const double s_far  = 20.0;
+static const double s_fov  = 30.0;
+
+struct Pose {
+	const char* name;
+	Matrix4x4   viewing;
+};
+
+struct Window {
+	const char* name;
+	int         width;
+	int         height;
+};
+
+struct Result {
+	long   drawn;
+	double checksum;
+};
+
+// Runs one frame of the pipeline over the whole scene
+static Result run_frame( const View& view, const Scene& scene,
+                         Scheduler& scheduler, LineList& lines,
+                         const Window* raster )
+{
+	Result result = { 0, 0.0 };
+
+	lines.clear();
+	render_scene( view, scene, lines, scheduler );
+
+	result.drawn = lines.size();
+	for ( size_t i = 0; i < lines.size(); i += 1 )
+	{
+		result.checksum += lines[i].p[0] + lines[i].p[1] +
+		                   lines[i].q[0] + lines[i].q[1];
+	}
+
+	// Draw the lines the way Viewer::on_expose_event does
+	if ( raster )
+	{
+		draw_init( raster->width, raster->height );
+		size_t colour = (size_t)-1;
+		for ( size_t i = 0; i < lines.size(); i += 1 )
+		{
+			if ( lines[i].colour != colour )
+			{
+				colour = lines[i].colour;
+				set_colour( lines.colour(colour) );
+			}
+			draw_line( lines[i].p, lines[i].q );
+		}
+		draw_complete();
+	}
+
+	return result;
+}
+
+// Sum of the colour channels of the software framebuffer
+static double pixel_checksum()
+{
+	const Framebuffer& frame = draw_framebuffer();
+	double             sum   = 0.0;
+
+	for ( int y = 0; y < frame.height(); y += 1 )
+	{
+		const uint32_t* row = frame.row( y );
+		for ( int x = 0; x < frame.width(); x += 1 )
+		{
+			sum += ( row[x] & 0xff ) + ( ( row[x] >> 8 ) & 0xff ) +
+			       ( ( row[x] >> 16 ) & 0xff );
+		}
+	}
+
+	return sum;
+}
+
+// Prints the time per operation of "name" and its speedup over "base",
+// and over "same", the same operation on the types of algebra.hpp, if
+// there is one
+static void report_micro( const char* name, double ns, double base,
+                          double same = 0.0 )
+{
+	printf( "  %-34s %8.2f ns %8.2fx", name, ns, base / ns );
+	if ( same > 0.0 )
+	{
+		printf( " %8.2fx", same / ns );
+	}
+	printf( "\n" );
+}
+
+// Times matrix-point and matrix-matrix products in isolation
+static void run_micro()
+{
+	const int count  = 4096;
+	const int rounds = 200;
+
+	Matrix4x4 viewing = translation( Vector3D(0.0, 0.0, 8.0) ) *
+	                    rotation( 0.5, 'z' );
+	Matrix4x4 model   = translation( Vector3D(1.0, 2.0, 3.0) ) *
+	                    rotation( 0.3, 'x' );
+	Matrix4x4 scale   = scaling( Vector3D(0.5, 2.0, 1.5) );
+	Matrix4x4 m       = viewing * model * scale;
+	Matrix4x4d md( m );
+	Matrix4x4f mf( m );
+
+	std::vector<Point3D> points;
+	std::vector<Point4f> pointsf;
+	for ( int i = 0; i < count; i += 1 )
+	{
+		Point3D p( sin(i * 0.1), cos(i * 0.7), sin(i * 1.3) );
+		points.push_back( p );
+		pointsf.push_back( Point4f(p) );
+	}
+
+	double  sink = 0.0;
+	double  start, base, same, ns;
+	long    ops  = (long)count * rounds;
+	Point4d outd;
+	Point4f outf;
+
+	printf( "Transform microbenchmark (%ld points; speedup over V*M*S*p, "
+	        "and over m*p)\n", ops );
+
+	start = stats_now_ns();
+	for ( int r = 0; r < rounds; r += 1 )
+	{
+		for ( int i = 0; i < count; i += 1 )
+		{
+			sink += ( viewing * model * scale * points[i] )[2];
+		}
+	}
+	base = ( stats_now_ns() - start ) / ops;
+	report_micro( "Matrix4x4 V*M*S*p per vertex", base, base );
+
+	start = stats_now_ns();
+	for ( int r = 0; r < rounds; r += 1 )
+	{
+		for ( int i = 0; i < count; i += 1 )
+		{
+			sink += ( m * points[i] )[2];
+		}
+	}
+	same = ( stats_now_ns() - start ) / ops;
+	report_micro( "Matrix4x4 m*p", same, base, same );
+
+	start = stats_now_ns();
+	for ( int r = 0; r < rounds; r += 1 )
+	{
+		for ( int i = 0; i < count; i += 1 )
+		{
+			const Point3D& p = points[i];
+			transform4( md, p[0], p[1], p[2], 1.0, outd.data() );
+			sink += outd[2];
+		}
+	}
+	ns = ( stats_now_ns() - start ) / ops;
+	report_micro( "Matrix4x4d m*p", ns, base, same );
+
+	start = stats_now_ns();
+	for ( int r = 0; r < rounds; r += 1 )
+	{
+		for ( int i = 0; i < count; i += 1 )
+		{
+			outf  = mf * pointsf[i];
+			sink += outf[2];
+		}
+	}
+	ns = ( stats_now_ns() - start ) / ops;
+	report_micro( "Matrix4x4f m*p", ns, base, same );
+
+	// The same points as structure-of-arrays, streamed through the
+	// batch kernel
+	std::vector<float> xs( count ), ys( count ), zs( count );
+	std::vector<float> ox( count ), oy( count ), oz( count );
+	for ( int i = 0; i < count; i += 1 )
+	{
+		xs[i] = pointsf[i][0];
+		ys[i] = pointsf[i][1];
+		zs[i] = pointsf[i][2];
+	}
+
+	start = stats_now_ns();
+	for ( int r = 0; r < rounds; r += 1 )
+	{
+		transform_points( mf, &xs[0], &ys[0], &zs[0], count,
+		                  &ox[0], &oy[0], &oz[0] );
+		sink += oz[r];
+	}
+	ns = ( stats_now_ns() - start ) / ops;
+	report_micro( "transform_points SoA", ns, base, same );
+
+	// Matrix-matrix products, chained so they can't be hoisted
+	Matrix4x4  acc  = m;
+	Matrix4x4d accd = md;
+	Matrix4x4f accf = mf;
+	Matrix4x4  step = rotation( 1e-4, 'y' );
+	Matrix4x4d stepd( step );
+	Matrix4x4f stepf( step );
+
+	printf( "Matrix product microbenchmark (%ld products)\n", ops / 4 );
+
+	start = stats_now_ns();
+	for ( long i = 0; i < ops / 4; i += 1 )
+	{
+		acc = acc * step;
+	}
+	base  = ( stats_now_ns() - start ) / ( ops / 4 );
+	sink += acc[0][0];
+	report_micro( "Matrix4x4 a*b", base, base );
+
+	start = stats_now_ns();
+	for ( long i = 0; i < ops / 4; i += 1 )
+	{
+		accd = accd * stepd;
+	}
+	ns    = ( stats_now_ns() - start ) / ( ops / 4 );
+	sink += accd( 0, 0 );
+	report_micro( "Matrix4x4d a*b", ns, base );
+
+	start = stats_now_ns();
+	for ( long i = 0; i < ops / 4; i += 1 )
+	{
+		accf = accf * stepf;
+	}
+	ns    = ( stats_now_ns() - start ) / ( ops / 4 );
+	sink += accf( 0, 0 );
+	report_micro( "Matrix4x4f a*b", ns, base );
+
+	// Keep the results alive
+	printf( "  (checksum %g)\n\n", sink );
+}
+
+// Scale movements queued in a MotionQueue against the same movements
+// applied one at a time, with every combination of buttons. Prints the
+// cases whose scales differ by more than rounding, and returns false if
+// there are any.
+static bool check_motion()
+{
+	static const int    runs  = 3;
+	static const int    steps = 10;
+	static const double deltas[runs][steps] = {
+		{ -15, -15, -15, -15, -15, -15, -15, -15, -15, -15 },
+		{ -60, -40, -60, -40, -60, -40, -60, -40, -60, -40 },
+		{ 12, -3, 25, -7, 0.5, -30, 8, 2, -1, 40 }
+	};
+
+	bool ok = true;
+	for ( int r = 0; r < runs; r += 1 )
+	{
+		for ( int b = 1; b < 8; b += 1 )
+		{
+			bool        b1 = ( b & 1 ) != 0;
+			bool        b2 = ( b & 2 ) != 0;
+			bool        b3 = ( b & 4 ) != 0;
+			Pipeline    direct, queued;
+			MotionQueue queue;
+
+			for ( int s = 0; s < steps; s += 1 )
+			{
+				direct.motion( Pipeline::MODELSCALE, b1, b2, b3,
+				               deltas[r][s] );
+				queue.add( queued, Pipeline::MODELSCALE, b1, b2, b3,
+				           deltas[r][s] );
+			}
+			queue.apply( queued );
+
+			const Vector3D& want = direct.scene().scale( 0 );
+			const Vector3D& got  = queued.scene().scale( 0 );
+			for ( int a = 0; a < 3; a += 1 )
+			{
+				if ( !( fabs(got[a] - want[a]) <= 1e-12 * fabs(want[a]) ) )
+				{
+					printf( "Run %d, buttons %d: scale %g instead of %g\n",
+					        r, b, got[a], want[a] );
+					ok = false;
+				}
+			}
+		}
+	}
+
+	printf( "Motion check: %s\n", ok ? "ok" : "failed" );
+	return ok;
+}
+
+static double percentile( std::vector<double>& values, double pct )
+{
+	size_t idx = (size_t)( pct / 100.0 * ( values.size() - 1 ) + 0.5 );
+	std::nth_element( values.begin(), values.begin() + idx, values.end() );
+	return values[idx];
+}
+
+static void usage( const char* name )
+{
+	fprintf( stderr, "Usage: %s [-max cubes] [-frames n] [-threads n] "
+	         "[-raster] [-micro] [-check]\n", name );
+	exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+	int  maxCubes = 1000000;
+	int  frames   = 0;
+	int  threads  = 0;
+	bool micro    = false;
+	bool check    = false;
+	bool raster   = false;
+
+	for ( int i = 1; i < argc; i += 1 )
+	{
+		if ( !strcmp(argv[i], "-max") && i + 1 < argc )
+		{
+			maxCubes = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-frames") && i + 1 < argc )
+		{
+			frames = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-threads") && i + 1 < argc )
+		{
+			threads = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-raster") )
+		{
+			raster = true;
+		}
+		else if ( !strcmp(argv[i], "-micro") )
+		{
+			micro = true;
+		}
+		else if ( !strcmp(argv[i], "-check") )
+		{
+			check = true;
+		}
+		else
+		{
+			usage( argv[0] );
+		}
+	}
+
+	if ( check )
+	{
+		return check_motion() ? 0 : 1;
+	}
+
+	run_micro();
+	if ( micro )
+	{
+		return 0;
+	}
+
+	// Camera poses, starting from the one set by Viewer::reset
+	Matrix4x4 back = translation( Vector3D(0.0, 0.0, 8.0) );
+	Pose poses[] = {
+		{ "front",   back },
+		{ "oblique", back * rotation( 0.5, 'z' ) * rotation( 0.7, 'x' ) },
+		{ "inside",  translation( Vector3D(0.0, 0.0, 3.0) ) },
+		{ "distant", translation( Vector3D(1.0, 1.0, 18.0) ) }
+	};
+	Window windows[] = {
+		{ "300x300",   300,  300  },
+		{ "1024x768",  1024, 768  },
+		{ "1920x1080", 1920, 1080 }
+	};
+	int nposes   = sizeof( poses )   / sizeof( poses[0] );
+	int nwindows = sizeof( windows ) / sizeof( windows[0] );
+
+	View view;
+	view.projection = perspective( s_fov, 1, s_near, s_far );
+	view.near       = s_near;
+	view.far        = s_far;
+
+	printf( "%8s %-8s %-10s %6s %9s %9s %8s %8s %8s %10s %14s\n",
+	        "cubes", "pose", "viewport", "frames", "edges", "drawn",
+	        "ns/p50", "ns/p90", "ns/p99", "Medges/s", "checksum" );
+
+	Scheduler scheduler( threads );
+	printf( "%d worker thread(s)\n", (int)scheduler.workers() );
+	draw_set_scheduler( &scheduler );
+
+	Scene    scene;
+	LineList lines;
+	for ( int cubes = 1; cubes <= maxCubes; cubes *= 10 )
+	{
+		// Lay the cubes out so every scene size covers the same part of
+		// the screen
+		scene.clear();
+		scene.add_grid( scene.add_mesh(unit_cube_mesh()), cubes, 3.0, 0.35 );
+
+		long edges = 12L * cubes;
+		// Aim for about a million edges per configuration
+		int  count = frames;
+		if ( count <= 0 )
+		{
+			count = (int)std::min( 10000L, std::max( 3L, 1000000L / edges ) );
+		}
+
+		for ( int w = 0; w < nwindows; w += 1 )
+		{
+			// Viewport set up the same way as in Viewer::on_expose_event
+			view.viewport[0] = Point2D( windows[w].width  * 0.05,
+			                            windows[w].height * 0.05 );
+			view.viewport[1] = Point2D( windows[w].width  * 0.95,
+			                            windows[w].height * 0.05 );
+			view.viewport[2] = Point2D( windows[w].width  * 0.95,
+			                            windows[w].height * 0.95 );
+			view.viewport[3] = Point2D( windows[w].width  * 0.05,
+			                            windows[w].height * 0.95 );
+
+			for ( int c = 0; c < nposes; c += 1 )
+			{
+				view.viewing = poses[c].viewing;
+
+				std::vector<double> nsPerEdge;
+				Result result = { 0, 0.0 };
+				double total  = 0.0;
+
+				for ( int f = 0; f < count; f += 1 )
+				{
+					double start = stats_now_ns();
+					result = run_frame( view, scene, scheduler, lines,
+					                    raster ? &windows[w] : NULL );
+					double elapsed = stats_now_ns() - start;
+
+					total += elapsed;
+					nsPerEdge.push_back( elapsed / edges );
+				}
+				if ( raster )
+				{
+					result.checksum += pixel_checksum();
+				}
+
+				printf( "%8d %-8s %-10s %6d %9ld %9ld %8.1f %8.1f %8.1f "
+				        "%10.2f %14.6e\n",
+				        cubes, poses[c].name, windows[w].name, count, edges,
+				        result.drawn, percentile( nsPerEdge, 50 ),
+				        percentile( nsPerEdge, 90 ),
+				        percentile( nsPerEdge, 99 ),
+				        edges * count / total * 1e3, result.checksum );
+				fflush( stdout );
+			}
+		}
+	}
+
+	printf( "\n%8s %12s %10s %10s %12s\n",
+	        "worker", "tasks", "steals", "misses", "idle ms" );
+	for ( size_t w = 0; w < scheduler.workers(); w += 1 )
+	{
+		const WorkerStats& stats = scheduler.stats( w );
+		printf( "%8d %12lu %10lu %10lu %12.2f\n", (int)w, stats.tasks,
+		        stats.steals, stats.misses, stats.idle_ns * 1e-6 );
+	}
+
+	return 0;
+}
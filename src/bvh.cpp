@@ -0,0 +1,211 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include "scene.hpp"
+
+
+// Orders instances by the centre of their spheres along one axis
+struct CentreLess {
+	const Sphere* spheres;
+	int           axis;
+
+	bool operator()( uint32_t a, uint32_t b ) const
+	{
+		return spheres[a].centre[axis] < spheres[b].centre[axis];
+	}
+};
+
+InstanceTree::InstanceTree()
+{
+}
+
+void InstanceTree::clear()
+{
+	m_nodes.clear();
+	m_parent.clear();
+	m_order.clear();
+	m_leaf.clear();
+	m_stale.clear();
+	m_marked.clear();
+}
+
+void InstanceTree::build( const Sphere* spheres, size_t n )
+{
+	clear();
+
+	if ( n == 0 )
+	{
+		return;
+	}
+
+	m_order.resize( n );
+	m_leaf.resize( n );
+	for ( size_t i = 0; i < n; i += 1 )
+	{
+		m_order[i] = (uint32_t)i;
+	}
+
+	// Leaves end up at least half full, so there are fewer than twice
+	// n / ( LEAF / 2 ) nodes; reserve so the recursion doesn't keep copying
+	// them
+	m_nodes.reserve( 2 * n / ( LEAF / 2 ) + 1 );
+	m_parent.reserve( m_nodes.capacity() );
+
+	m_nodes.push_back( Node() );
+	m_parent.push_back( 0 );
+	split( 0, spheres, 0, (uint32_t)n );
+
+	m_marked.assign( m_nodes.size(), 0 );
+}
+
+void InstanceTree::split( uint32_t n, const Sphere* spheres, uint32_t first,
+                          uint32_t count )
+{
+	m_nodes[n].first = first;
+	m_nodes[n].count = count;
+	m_nodes[n].child = 0;
+
+	if ( count <= LEAF )
+	{
+		for ( uint32_t i = first; i < first + count; i += 1 )
+		{
+			m_leaf[m_order[i]] = n;
+		}
+		fit_leaf( n, spheres );
+		return;
+	}
+
+	// Split at the median centre along the axis they are most spread on
+	Point3D lo = spheres[m_order[first]].centre;
+	Point3D hi = lo;
+	for ( uint32_t i = first + 1; i < first + count; i += 1 )
+	{
+		const Point3D& c = spheres[m_order[i]].centre;
+		for ( int a = 0; a < 3; a += 1 )
+		{
+			lo[a] = std::min( lo[a], c[a] );
+			hi[a] = std::max( hi[a], c[a] );
+		}
+	}
+	int axis = 0;
+	for ( int a = 1; a < 3; a += 1 )
+	{
+		if ( hi[a] - lo[a] > hi[axis] - lo[axis] )
+		{
+			axis = a;
+		}
+	}
+
+	uint32_t   half = count / 2;
+	CentreLess less = { spheres, axis };
+	std::nth_element( m_order.begin() + first, m_order.begin() + first + half,
+	                  m_order.begin() + first + count, less );
+
+	uint32_t child = (uint32_t)m_nodes.size();
+	m_nodes[n].child = child;
+	m_nodes.push_back( Node() );
+	m_nodes.push_back( Node() );
+	m_parent.push_back( n );
+	m_parent.push_back( n );
+
+	split( child,     spheres, first,        half );
+	split( child + 1, spheres, first + half, count - half );
+	fit_inner( n );
+}
+
+void InstanceTree::fit_leaf( uint32_t n, const Sphere* spheres )
+{
+	Node& node = m_nodes[n];
+
+	for ( uint32_t i = node.first; i < node.first + node.count; i += 1 )
+	{
+		const Sphere& s = spheres[m_order[i]];
+		for ( int a = 0; a < 3; a += 1 )
+		{
+			double lo = s.centre[a] - s.radius;
+			double hi = s.centre[a] + s.radius;
+			node.lo[a] = ( i == node.first ) ? lo : std::min( node.lo[a], lo );
+			node.hi[a] = ( i == node.first ) ? hi : std::max( node.hi[a], hi );
+		}
+	}
+}
+
+void InstanceTree::fit_inner( uint32_t n )
+{
+	Node&       node  = m_nodes[n];
+	const Node& left  = m_nodes[node.child];
+	const Node& right = m_nodes[node.child + 1];
+
+	for ( int a = 0; a < 3; a += 1 )
+	{
+		node.lo[a] = std::min( left.lo[a], right.lo[a] );
+		node.hi[a] = std::max( left.hi[a], right.hi[a] );
+	}
+}
+
+void InstanceTree::moved( size_t i )
+{
+	uint32_t leaf = m_leaf[i];
+
+	if ( !m_marked[leaf] )
+	{
+		m_marked[leaf] = 1;
+		m_stale.push_back( leaf );
+	}
+}
+
+void InstanceTree::refit( const Sphere* spheres )
+{
+	// With more than a quarter of the leaves to do (about half the nodes
+	// are leaves), one pass over every node, children before parents,
+	// beats walking up from each leaf
+	if ( m_stale.size() > m_nodes.size() / 8 )
+	{
+		for ( size_t n = m_nodes.size(); n-- > 0; )
+		{
+			if ( m_nodes[n].child == 0 )
+			{
+				fit_leaf( (uint32_t)n, spheres );
+			}
+			else
+			{
+				fit_inner( (uint32_t)n );
+			}
+		}
+	}
+	else
+	{
+		for ( size_t l = 0; l < m_stale.size(); l += 1 )
+		{
+			uint32_t n = m_stale[l];
+			fit_leaf( n, spheres );
+
+			// Up to the first ancestor the change makes no difference to
+			while ( n != 0 )
+			{
+				n = m_parent[n];
+
+				Node before = m_nodes[n];
+				fit_inner( n );
+
+				const Node& after = m_nodes[n];
+				bool        same  = true;
+				for ( int a = 0; a < 3; a += 1 )
+				{
+					same = same && before.lo[a] == after.lo[a] &&
+					       before.hi[a] == after.hi[a];
+				}
+				if ( same )
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	for ( size_t l = 0; l < m_stale.size(); l += 1 )
+	{
+		m_marked[m_stale[l]] = 0;
+	}
+	m_stale.clear();
+}
@@ -0,0 +1,85 @@
+#ifndef CS488_BVH_HPP
+#define CS488_BVH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "algebra.hpp"
+
+struct Sphere;
+
+
+// A bounding volume hierarchy over the bounding spheres of a scene's
+// instances, so the renderer can cull whole groups of them with one test.
+// Every node has an axis-aligned box around the spheres under it, and the
+// range of order() they fill: leaves hold up to LEAF instances, and inner
+// nodes two children, the second straight after the first.
+//
+// Building splits the instances at the median of their centres along the
+// longest axis, level by level, which costs O(n log n) and is only needed
+// when instances come or go. When they move, moved() marks their leaves
+// and refit() recomputes the boxes of those leaves and of their ancestors
+// up to the first that doesn't change. The shape of the tree stays put,
+// so it gets looser as instances travel, but never wrong.
+class InstanceTree {
+public:
+	// Most instances in a leaf
+	enum { LEAF = 8 };
+
+	struct Node {
+		Point3D  lo;
+		Point3D  hi;
+		// The instances under the node, order()[first] on
+		uint32_t first;
+		uint32_t count;
+		// Index of the first child, or 0 for a leaf
+		uint32_t child;
+	};
+
+	InstanceTree();
+
+	// Removes all nodes
+	void            clear     ();
+
+	// Builds the tree over the n spheres, instance i having spheres[i]
+	void            build     ( const Sphere* spheres, size_t n );
+
+	// Marks the leaf holding instance i for the next refit
+	void            moved     ( size_t i );
+	bool            stale     () const { return !m_stale.empty(); }
+
+	// Fits the boxes of the marked leaves, and their ancestors, to the
+	// spheres of their instances again
+	void            refit     ( const Sphere* spheres );
+
+	// Node 0 is the root, if there are any nodes
+	size_t          node_count() const { return m_nodes.size(); }
+	const Node&     node      ( size_t n ) const { return m_nodes[n]; }
+
+	// The instances, leaf by leaf
+	const uint32_t* order     () const
+	{
+		return m_order.empty() ? NULL : &m_order[0];
+	}
+
+private:
+	// Makes node n a leaf or splits it, over order()[first, first + count)
+	void            split     ( uint32_t n, const Sphere* spheres,
+	                            uint32_t first, uint32_t count );
+
+	// Recomputes the box of node n from its spheres or its children
+	void            fit_leaf  ( uint32_t n, const Sphere* spheres );
+	void            fit_inner ( uint32_t n );
+
+	std::vector<Node>     m_nodes;
+	std::vector<uint32_t> m_parent;
+	std::vector<uint32_t> m_order;
+	// The leaf of each instance
+	std::vector<uint32_t> m_leaf;
+	// The leaves marked since the last refit, with a flag per node so
+	// each is listed once
+	std::vector<uint32_t> m_stale;
+	std::vector<char>     m_marked;
+};
+
+#endif
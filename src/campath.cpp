@@ -0,0 +1,128 @@
+#include "campath.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+void CameraPath::add( double frame, const Vector3D& position,
+                      const Quaternion& orientation )
+{
+	Key key = { frame, position, orientation.normalize() };
+
+	std::vector<Key>::iterator i = m_keys.begin();
+	while ( i != m_keys.end() && i->frame < frame )
+	{
+		++i;
+	}
+
+	if ( i != m_keys.end() && i->frame == frame )
+	{
+		*i = key;
+	}
+	else
+	{
+		m_keys.insert( i, key );
+	}
+}
+
+bool CameraPath::load( const char* filename, std::string& error )
+{
+	FILE* file = fopen( filename, "r" );
+	if ( !file )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		return false;
+	}
+
+	m_keys.clear();
+
+	char line[512];
+	int  number = 0;
+	while ( fgets(line, sizeof(line), file) )
+	{
+		number += 1;
+
+		char* comment = strchr( line, '#' );
+		if ( comment )
+		{
+			*comment = '\0';
+		}
+
+		double frame, x, y, z, angle, ax, ay, az;
+		char   rest;
+		int    fields = sscanf( line, "%lf %lf %lf %lf %lf %lf %lf %lf %c",
+		                        &frame, &x, &y, &z, &angle, &ax, &ay, &az,
+		                        &rest );
+		if ( fields == EOF )
+		{
+			continue;
+		}
+
+		Vector3D axis( ax, ay, az );
+		if ( fields != 8 || axis.length2() == 0.0 )
+		{
+			char where[32];
+			snprintf( where, sizeof(where), ":%d: ", number );
+			error = std::string( filename ) + where +
+			        "expected: frame x y z angle ax ay az";
+			fclose( file );
+			return false;
+		}
+
+		add( frame, Vector3D(x, y, z),
+		     Quaternion::axis_angle(axis, angle * M_PI / 180.0) );
+	}
+
+	fclose( file );
+
+	if ( m_keys.empty() )
+	{
+		error = std::string( filename ) + ": no keyframes";
+		return false;
+	}
+
+	return true;
+}
+
+CameraPath CameraPath::orbit( const Vector3D& position, double frames )
+{
+	CameraPath path;
+
+	// Quarter turns, so slerp goes the right way round
+	for ( int i = 0; i <= 4; i += 1 )
+	{
+		path.add( frames * i / 4, position,
+		          Quaternion::axis_angle(Vector3D(0.0, 1.0, 0.0),
+		                                 M_PI / 2 * i) );
+	}
+
+	return path;
+}
+
+void CameraPath::sample( double frame, Vector3D& position,
+                         Quaternion& orientation ) const
+{
+	// The first keyframe after "frame"
+	size_t next = 0;
+	while ( next < m_keys.size() && m_keys[next].frame <= frame )
+	{
+		next += 1;
+	}
+
+	if ( next == 0 || next == m_keys.size() )
+	{
+		const Key& key = m_keys[next == 0 ? 0 : next - 1];
+		position    = key.position;
+		orientation = key.orientation;
+		return;
+	}
+
+	const Key& a = m_keys[next - 1];
+	const Key& b = m_keys[next];
+	double     t = ( frame - a.frame ) / ( b.frame - a.frame );
+
+	position    = a.position + t * ( b.position - a.position );
+	orientation = slerp( a.orientation, b.orientation, t );
+}
@@ -0,0 +1,62 @@
+#ifndef CS488_CAMPATH_HPP
+#define CS488_CAMPATH_HPP
+
+#include <string>
+#include <vector>
+#include "quaternion.hpp"
+
+
+// A camera moving through a scene, for rendering without a user at the
+// mouse. The path is a list of keyframes, each a camera as taken by
+// Pipeline::set_camera at some frame number; in between, the position is
+// interpolated linearly and the orientation by slerp, which takes the
+// shorter way round, so keyframes should be less than half a turn apart.
+//
+// Path files are text with one keyframe per line:
+//
+//     frame  x y z  angle ax ay az
+//
+// placing the camera at ( x, y, z ), turned "angle" degrees about the axis
+// ( ax, ay, az ), at that frame. Keyframes may come in any order; blank
+// lines and everything after a '#' are ignored.
+class CameraPath {
+public:
+	struct Key {
+		double     frame;
+		Vector3D   position;
+		Quaternion orientation;
+	};
+
+	// Adds a keyframe, replacing any at the same frame
+	void        add     ( double frame, const Vector3D& position,
+	                      const Quaternion& orientation );
+
+	// Replaces the path with the one in "filename". Returns false and
+	// describes the problem in "error" if the file can't be read.
+	bool        load    ( const char* filename, std::string& error );
+
+	// One turn about the vertical axis of the scene over "frames" frames,
+	// starting from the camera at "position"
+	static CameraPath orbit( const Vector3D& position, double frames );
+
+	bool        empty   () const { return m_keys.empty(); }
+	size_t      size    () const { return m_keys.size(); }
+	const Key&  key     ( size_t i ) const { return m_keys[i]; }
+
+	// The frame of the last keyframe
+	double      length  () const
+	{
+		return m_keys.empty() ? 0.0 : m_keys.back().frame;
+	}
+
+	// The camera at "frame", held at the first and last keyframes outside
+	// their range. The path must not be empty.
+	void        sample  ( double frame, Vector3D& position,
+	                      Quaternion& orientation ) const;
+
+private:
+	// Sorted by frame
+	std::vector<Key> m_keys;
+};
+
+#endif
@@ -20,17 +20,57 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 
+#include <vector>
+
 #include "draw.hpp"
+#include "tiles.hpp"
+
+// Lines are not sent to GL one vertex at a time. Instead draw_line and
+// set_colour append to a batch of interleaved position and colour data,
+// which draw_complete submits with a single glDrawArrays call.
+struct BatchVertex
+{
+  GLfloat x, y;
+  GLfloat r, g, b;
+};
+
+static std::vector<BatchVertex> batch;
+static GLfloat                  batch_colour[3] = { 0.0f, 0.0f, 0.0f };
+
+// The software rasterizer, when selected: lines go straight to the tiles
+// instead of the batch
+static bool        software = false;
+static Framebuffer framebuffer;
+static TiledRaster tiles;
+static uint32_t    tiles_pixel = Framebuffer::pack(Colour(0.0));
+static Scheduler*  scheduler = NULL;
+static int         frame_width = 0, frame_height = 0;
+
+static void batch_vertex(double x, double y)
+{
+  BatchVertex v = { (GLfloat)x, (GLfloat)y,
+                    batch_colour[0], batch_colour[1], batch_colour[2] };
+  batch.push_back(v);
+}
 
 void draw_line(const Point2D& p, const Point2D& q)
 {
-  glVertex2d(p[0], p[1]);
-  glVertex2d(q[0], q[1]);
+  if (software) {
+    tiles.add(p, q, tiles_pixel);
+    return;
+  }
+
+  batch_vertex(p[0], p[1]);
+  batch_vertex(q[0], q[1]);
 }
 
 void set_colour(const Colour& col)
 {
-  glColor3f((float)col.R(), (float)col.G(), (float)col.B());
+  batch_colour[0] = (GLfloat)col.R();
+  batch_colour[1] = (GLfloat)col.G();
+  batch_colour[2] = (GLfloat)col.B();
+
+  tiles_pixel = Framebuffer::pack(col);
 }
 
 void draw_init(int width, int height)
@@ -54,10 +94,71 @@ void draw_init(int width, int height)
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glLineWidth(1.0);
 
-  glBegin(GL_LINES);
+  // Start a new batch, keeping the storage of the previous frame
+  batch.clear();
+  tiles.begin(width, height);
+
+  frame_width  = width;
+  frame_height = height;
+}
+
+void draw_set_software(bool on)
+{
+  software = on;
+}
+
+void draw_set_scheduler(Scheduler* s)
+{
+  scheduler = s;
+}
+
+const Framebuffer& draw_framebuffer()
+{
+  return framebuffer;
+}
+
+// Rasterizes the tiles in software and copies the result to the window
+static void draw_software()
+{
+  if (!scheduler) {
+    static Scheduler own;
+    scheduler = &own;
+  }
+
+  tiles.render(framebuffer, Framebuffer::pack(Colour(0.7, 0.7, 0.7)),
+               *scheduler);
+
+  if (frame_width == 0 || frame_height == 0) {
+    return;
+  }
+
+  // Rows run from the top, as the flipped modelview of draw_init does
+  glDisable(GL_BLEND);
+  glRasterPos2i(0, 0);
+  glPixelZoom(1.0f, -1.0f);
+  glDrawPixels(frame_width, frame_height, GL_RGBA, GL_UNSIGNED_BYTE,
+               framebuffer.pixels());
+  glPixelZoom(1.0f, 1.0f);
 }
 
 void draw_complete()
 {
-  glEnd();
+  if (software) {
+    draw_software();
+    return;
+  }
+
+  if (batch.empty()) {
+    return;
+  }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(BatchVertex), &batch[0].x);
+  glColorPointer(3, GL_FLOAT, sizeof(BatchVertex), &batch[0].r);
+
+  glDrawArrays(GL_LINES, 0, (GLsizei)batch.size());
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
 }
@@ -17,6 +17,9 @@
 #define CS488_DRAW_HPP
 
 #include "algebra.hpp"
+#include "raster.hpp"
+
+class Scheduler;
 
 // Draw a line -- call draw_init first!
 void draw_line(const Point2D& p, const Point2D& q);
@@ -28,7 +31,23 @@ void set_colour(const Colour& col);
 // and height of the GL window.
 void draw_init(int width, int height);
 
-// Call this after all lines have been drawn for one frame
+// Call this after all lines have been drawn for one frame. Lines are
+// batched up and only submitted to GL here.
 void draw_complete();
 
+// Draw with the software rasterizer of raster.hpp instead of GL lines.
+// The frame then goes into draw_framebuffer(), which draw_complete copies
+// to the GL window. draw_soft.cpp, the backend for builds without GL,
+// always draws this way.
+void draw_set_software(bool software);
+
+// Rasterize software frames tile by tile on the workers of "scheduler"
+// (see tiles.hpp), which must outlive the drawing. Until this is called,
+// the backend uses a scheduler of its own.
+void draw_set_scheduler(Scheduler* scheduler);
+
+// The frame drawn by the software rasterizer, complete once
+// draw_complete returns
+const Framebuffer& draw_framebuffer();
+
 #endif // CS488_DRAW_HPP
@@ -0,0 +1,60 @@
+/****************************************************************************
+ *
+ * draw_soft.cpp
+ *
+ * The drawing functions of draw.hpp with no GL at all: lines are collected
+ * into a tiled rasterizer (see tiles.hpp) and drawn into an in-memory
+ * framebuffer by draw_complete, for programs that render headlessly. Link
+ * this instead of draw.cpp.
+ *
+ ****************************************************************************/
+
+#include "draw.hpp"
+#include "tiles.hpp"
+
+static Framebuffer framebuffer;
+static TiledRaster tiles;
+static uint32_t    pixel = Framebuffer::pack(Colour(0.0));
+static Scheduler*  scheduler = NULL;
+
+void draw_line(const Point2D& p, const Point2D& q)
+{
+  tiles.add(p, q, pixel);
+}
+
+void set_colour(const Colour& col)
+{
+  pixel = Framebuffer::pack(col);
+}
+
+void draw_init(int width, int height)
+{
+  tiles.begin(width, height);
+}
+
+void draw_complete()
+{
+  if (!scheduler) {
+    static Scheduler own;
+    scheduler = &own;
+  }
+
+  // Same background as the GL backend
+  tiles.render(framebuffer, Framebuffer::pack(Colour(0.7, 0.7, 0.7)),
+               *scheduler);
+}
+
+void draw_set_software(bool)
+{
+  // There is nothing else to draw with
+}
+
+void draw_set_scheduler(Scheduler* s)
+{
+  scheduler = s;
+}
+
+const Framebuffer& draw_framebuffer()
+{
+  return framebuffer;
+}
@@ -0,0 +1,244 @@
+#include "edgeclip.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+void ProjectedPoints::resize( size_t n )
+{
+	codes.resize( n );
+	px.resize( n );
+	py.resize( n );
+}
+
+// A thin layer over the vector instructions, so the kernel below is
+// written once for both widths
+#if defined(__AVX__)
+#define EDGECLIP_LANES 8
+typedef __m256 vfloat;
+
+static inline vfloat vload ( const float* p )    { return _mm256_loadu_ps( p ); }
+static inline void   vstore( float* p, vfloat a ) { _mm256_storeu_ps( p, a ); }
+static inline vfloat vset  ( float f )           { return _mm256_set1_ps( f ); }
+// A lane holding the bit pattern "bits", for building outcodes in
+static inline vfloat vbits ( int bits )
+{
+	return _mm256_castsi256_ps( _mm256_set1_epi32(bits) );
+}
+static inline void   vstorei( int* p, vfloat a )
+{
+	_mm256_storeu_si256( (__m256i*)p, _mm256_castps_si256(a) );
+}
+static inline vfloat vadd  ( vfloat a, vfloat b ) { return _mm256_add_ps( a, b ); }
+static inline vfloat vmul  ( vfloat a, vfloat b ) { return _mm256_mul_ps( a, b ); }
+static inline vfloat vdiv  ( vfloat a, vfloat b ) { return _mm256_div_ps( a, b ); }
+static inline vfloat vand  ( vfloat a, vfloat b ) { return _mm256_and_ps( a, b ); }
+static inline vfloat vor   ( vfloat a, vfloat b ) { return _mm256_or_ps( a, b ); }
+static inline vfloat vlt   ( vfloat a, vfloat b )
+{
+	return _mm256_cmp_ps( a, b, _CMP_LT_OQ );
+}
+static inline vfloat vgt   ( vfloat a, vfloat b )
+{
+	return _mm256_cmp_ps( a, b, _CMP_GT_OQ );
+}
+// !( a > b ), true for NaNs
+static inline vfloat vngt  ( vfloat a, vfloat b )
+{
+	return _mm256_cmp_ps( a, b, _CMP_NGT_UQ );
+}
+#elif defined(__SSE2__)
+#define EDGECLIP_LANES 4
+typedef __m128 vfloat;
+
+static inline vfloat vload ( const float* p )    { return _mm_loadu_ps( p ); }
+static inline void   vstore( float* p, vfloat a ) { _mm_storeu_ps( p, a ); }
+static inline vfloat vset  ( float f )           { return _mm_set1_ps( f ); }
+// A lane holding the bit pattern "bits", for building outcodes in
+static inline vfloat vbits ( int bits )
+{
+	return _mm_castsi128_ps( _mm_set1_epi32(bits) );
+}
+static inline void   vstorei( int* p, vfloat a )
+{
+	_mm_storeu_si128( (__m128i*)p, _mm_castps_si128(a) );
+}
+static inline vfloat vadd  ( vfloat a, vfloat b ) { return _mm_add_ps( a, b ); }
+static inline vfloat vmul  ( vfloat a, vfloat b ) { return _mm_mul_ps( a, b ); }
+static inline vfloat vdiv  ( vfloat a, vfloat b ) { return _mm_div_ps( a, b ); }
+static inline vfloat vand  ( vfloat a, vfloat b ) { return _mm_and_ps( a, b ); }
+static inline vfloat vor   ( vfloat a, vfloat b ) { return _mm_or_ps( a, b ); }
+static inline vfloat vlt   ( vfloat a, vfloat b ) { return _mm_cmplt_ps( a, b ); }
+static inline vfloat vgt   ( vfloat a, vfloat b ) { return _mm_cmpgt_ps( a, b ); }
+// !( a > b ), true for NaNs
+static inline vfloat vngt  ( vfloat a, vfloat b ) { return _mm_cmpngt_ps( a, b ); }
+#endif
+
+void project_points( const Clipper& clipper, const float* x, const float* y,
+                     const float* z, size_t n, ProjectedPoints& out )
+{
+	size_t i = 0;
+
+	if ( out.size() < n )
+	{
+		out.resize( n );
+	}
+
+	// The clipper's parameters, as in Clipper::outcode, in single precision
+	float proj[3][4];
+	for ( int r = 0; r < 3; r += 1 )
+	{
+		for ( int c = 0; c < 4; c += 1 )
+		{
+			proj[r][c] = (float)clipper.m_proj[r][c];
+		}
+	}
+	float near = (float)clipper.m_view.near;
+	float far  = (float)clipper.m_view.far;
+	float x0   = (float)clipper.m_x0, y0 = (float)clipper.m_y0;
+	float sx   = (float)clipper.m_sx, sy = (float)clipper.m_sy;
+
+#if defined(EDGECLIP_LANES)
+	const int LANES = EDGECLIP_LANES;
+
+	// Broadcast them
+	vfloat p00 = vset( proj[0][0] ), p01 = vset( proj[0][1] ),
+	       p02 = vset( proj[0][2] ), p03 = vset( proj[0][3] );
+	vfloat p10 = vset( proj[1][0] ), p11 = vset( proj[1][1] ),
+	       p12 = vset( proj[1][2] ), p13 = vset( proj[1][3] );
+	vfloat p20 = vset( proj[2][0] ), p21 = vset( proj[2][1] ),
+	       p22 = vset( proj[2][2] ), p23 = vset( proj[2][3] );
+
+	vfloat vnear = vset( near ), vfar = vset( far );
+	vfloat zero  = vset( 0.0f );
+	vfloat half  = vset( 1.5f );
+	vfloat nhalf = vset( -1.5f );
+	vfloat vx0   = vset( x0 ), vy0 = vset( y0 );
+	vfloat vsx   = vset( sx ), vsy = vset( sy );
+
+	// The outcode bits, and the ones every point gets
+	vfloat nearBit   = vbits( Clipper::NEAR ),  farBit    = vbits( Clipper::FAR );
+	vfloat leftBit   = vbits( Clipper::LEFT ),  rightBit  = vbits( Clipper::RIGHT );
+	vfloat topBit    = vbits( Clipper::TOP ),   bottomBit = vbits( Clipper::BOTTOM );
+	vfloat unsureBit = vbits( Clipper::UNSURE );
+	vfloat always    = vbits( clipper.m_always );
+
+	for ( ; i + LANES <= n; i += LANES )
+	{
+		vfloat vx = vload( x + i ), vy = vload( y + i ), vz = vload( z + i );
+
+		// Homogeneous coordinates
+		vfloat X = vadd( vadd(vmul(p00, vx), vmul(p01, vy)),
+		                 vadd(vmul(p02, vz), p03) );
+		vfloat Y = vadd( vadd(vmul(p10, vx), vmul(p11, vy)),
+		                 vadd(vmul(p12, vz), p13) );
+		vfloat W = vadd( vadd(vmul(p20, vx), vmul(p21, vy)),
+		                 vadd(vmul(p22, vz), p23) );
+
+		// One mask per outcode bit, each cut down to its bit. Where W <= 0
+		// the viewport bits are meaningless, but the UNSURE bit keeps the
+		// edge tests from trusting them.
+		vfloat code = vor( vor(vand(vlt(vz, vnear), nearBit),
+		                       vand(vgt(vz, vfar), farBit)),
+		                   vor(vand(vngt(W, zero), unsureBit), always) );
+		code = vor( code, vor(vand(vlt(X, vmul(nhalf, W)), leftBit),
+		                      vand(vgt(X, vmul(half, W)), rightBit)) );
+		code = vor( code, vor(vand(vlt(Y, vmul(nhalf, W)), topBit),
+		                      vand(vgt(Y, vmul(half, W)), bottomBit)) );
+		vstorei( &out.codes[i], code );
+
+		// Project every lane; only the inside ones are used
+		vstore( &out.px[i], vadd(vmul(vadd(vdiv(X, W), half), vsx), vx0) );
+		vstore( &out.py[i], vadd(vmul(vadd(vdiv(Y, W), half), vsy), vy0) );
+	}
+#endif
+
+	// Whatever is left over, one point at a time in the same steps as a
+	// lane, so a point comes out the same wherever it falls in a batch
+	for ( ; i < n; i += 1 )
+	{
+		float X = ( proj[0][0] * x[i] + proj[0][1] * y[i] ) +
+		          ( proj[0][2] * z[i] + proj[0][3] );
+		float Y = ( proj[1][0] * x[i] + proj[1][1] * y[i] ) +
+		          ( proj[1][2] * z[i] + proj[1][3] );
+		float W = ( proj[2][0] * x[i] + proj[2][1] * y[i] ) +
+		          ( proj[2][2] * z[i] + proj[2][3] );
+
+		int code = clipper.m_always;
+		if ( z[i] < near )   code |= Clipper::NEAR;
+		if ( z[i] > far )    code |= Clipper::FAR;
+		if ( !(W > 0.0f) )   code |= Clipper::UNSURE;
+		if ( X < -1.5f * W ) code |= Clipper::LEFT;
+		if ( X >  1.5f * W ) code |= Clipper::RIGHT;
+		if ( Y < -1.5f * W ) code |= Clipper::TOP;
+		if ( Y >  1.5f * W ) code |= Clipper::BOTTOM;
+
+		out.codes[i] = code;
+		out.px[i]    = ( X / W + 1.5f ) * sx + x0;
+		out.py[i]    = ( Y / W + 1.5f ) * sy + y0;
+	}
+}
+
+size_t clip_mesh( const Clipper& clipper, const MeshView& mesh, size_t first,
+                  bool inside, const float* x, const float* y, const float* z,
+                  const ProjectedPoints& points, LineList& lines )
+{
+	const int*    codes = &points.codes[first];
+	const float*  px    = &points.px[first];
+	const float*  py    = &points.py[first];
+	const Colour* last  = NULL;
+	size_t        added = 0;
+
+	x += first;
+	y += first;
+	z += first;
+
+	for ( size_t e = 0; e < mesh.edge_count; e += 1 )
+	{
+		int a     = mesh.edges[2 * e];
+		int b     = mesh.edges[2 * e + 1];
+		int codeA = codes[a];
+		int codeB = codes[b];
+
+		// The tests of Clipper::clip, on the outcodes of the vertices
+		Point2D p, q;
+		if ( inside || ( codeA | codeB ) == 0 )
+		{
+			p = Point2D( px[a], py[a] );
+			q = Point2D( px[b], py[b] );
+		}
+		else
+		{
+			int common = codeA & codeB;
+			if ( ( common & ( Clipper::NEAR | Clipper::FAR ) ) ||
+			     ( common && !( ( codeA | codeB ) & Clipper::UNSURE ) ) )
+			{
+				continue;
+			}
+			if ( !clipper.clip(Point3D(x[a], y[a], z[a]),
+			                   Point3D(x[b], y[b], z[b]), p, q) )
+			{
+				continue;
+			}
+			p = Point2D( (float)p[0], (float)p[1] );
+			q = Point2D( (float)q[0], (float)q[1] );
+		}
+
+		// Most meshes are one colour, so skip the comparison when the
+		// palette entry is the same as last time
+		const Colour* colour = &mesh.palette[mesh.colours[e]];
+		if ( colour != last )
+		{
+			lines.set_colour( *colour );
+			last = colour;
+		}
+		lines.add( p, q );
+		added += 1;
+	}
+
+	return added;
+}
@@ -0,0 +1,43 @@
+#ifndef CS488_EDGECLIP_HPP
+#define CS488_EDGECLIP_HPP
+
+#include <vector>
+#include "algebra.hpp"
+#include "pipeline.hpp"
+
+
+// The outcodes and window coordinates of a run of points in viewing
+// coordinates, stored as structure of arrays. Each vertex of a mesh is
+// projected into here once, however many edges meet at it, and the edges
+// are then put together from the vertex indices.
+class ProjectedPoints {
+public:
+	void   resize( size_t n );
+	size_t size  () const { return codes.size(); }
+
+	// Clipper outcode of each point
+	std::vector<int>   codes;
+	// Window coordinates, only meaningful where the outcode is zero
+	std::vector<float> px, py;
+};
+
+// Works out the outcodes and window coordinates of the n points, 4 (SSE)
+// or 8 (AVX) at a time, with the same tests as Clipper::outcode done in
+// single precision
+void   project_points( const Clipper& clipper, const float* x, const float* y,
+                       const float* z, size_t n, ProjectedPoints& out );
+
+// Clips the edges of "mesh", whose vertices were transformed to viewing
+// coordinates at index "first" on of x, y and z and projected into
+// "points", and appends the survivors to "lines" in edge order. Edges
+// with both ends inside are drawn from the projected points, edges with
+// both ends outside the same plane are dropped, and only the rest go
+// through Clipper::clip. If the whole mesh is known to be "inside", every
+// edge is drawn without looking at the outcodes. Returns the number of
+// lines added.
+size_t clip_mesh     ( const Clipper& clipper, const MeshView& mesh,
+                       size_t first, bool inside, const float* x,
+                       const float* y, const float* z,
+                       const ProjectedPoints& points, LineList& lines );
+
+#endif
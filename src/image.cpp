@@ -0,0 +1,136 @@
+#include "image.hpp"
+
+#include <errno.h>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+
+
+// Row y of the frame as RGB bytes
+static void pack_row( const Framebuffer& frame, int y, unsigned char* out )
+{
+	const uint32_t* row = frame.row( y );
+	for ( int x = 0; x < frame.width(); x += 1 )
+	{
+		out[0] = (unsigned char)( row[x] );
+		out[1] = (unsigned char)( row[x] >> 8 );
+		out[2] = (unsigned char)( row[x] >> 16 );
+		out     += 3;
+	}
+}
+
+bool write_raw( const Framebuffer& frame, FILE* file )
+{
+	if ( frame.width() == 0 )
+	{
+		return true;
+	}
+
+	std::vector<unsigned char> row( (size_t)frame.width() * 3 );
+	for ( int y = 0; y < frame.height(); y += 1 )
+	{
+		pack_row( frame, y, &row[0] );
+		if ( fwrite(&row[0], 1, row.size(), file) != row.size() )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool write_ppm( const Framebuffer& frame, FILE* file )
+{
+	if ( fprintf(file, "P6\n%d %d\n255\n", frame.width(), frame.height()) < 0 )
+	{
+		return false;
+	}
+
+	return write_raw( frame, file );
+}
+
+// Writes a PNG chunk: length, type, data and the CRC of type and data
+static bool write_chunk( FILE* file, const char* type,
+                         const unsigned char* data, size_t size )
+{
+	unsigned char header[8] = {
+		(unsigned char)( size >> 24 ), (unsigned char)( size >> 16 ),
+		(unsigned char)( size >> 8 ),  (unsigned char)( size ),
+		(unsigned char)type[0], (unsigned char)type[1],
+		(unsigned char)type[2], (unsigned char)type[3]
+	};
+
+	// crc32 starts over when given no data, so skip empty chunks' data
+	uLong crc = crc32( 0L, header + 4, 4 );
+	if ( size > 0 )
+	{
+		crc = crc32( crc, data, (uInt)size );
+	}
+
+	unsigned char trailer[4] = {
+		(unsigned char)( crc >> 24 ), (unsigned char)( crc >> 16 ),
+		(unsigned char)( crc >> 8 ),  (unsigned char)( crc )
+	};
+
+	return fwrite( header, 1, 8, file ) == 8 &&
+	       ( size == 0 || fwrite(data, 1, size, file) == size ) &&
+	       fwrite( trailer, 1, 4, file ) == 4;
+}
+
+bool write_png( const Framebuffer& frame, FILE* file, int level )
+{
+	static const unsigned char signature[8] = {
+		0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+	};
+
+	int w = frame.width(), h = frame.height();
+
+	// IHDR: size, 8 bits per channel, colour type 2 (RGB), deflate, no
+	// interlacing
+	unsigned char ihdr[13] = {
+		(unsigned char)( w >> 24 ), (unsigned char)( w >> 16 ),
+		(unsigned char)( w >> 8 ),  (unsigned char)( w ),
+		(unsigned char)( h >> 24 ), (unsigned char)( h >> 16 ),
+		(unsigned char)( h >> 8 ),  (unsigned char)( h ),
+		8, 2, 0, 0, 0
+	};
+
+	// Each row is preceded by its filter type, 0 for none
+	size_t                     stride = (size_t)w * 3 + 1;
+	std::vector<unsigned char> raw( stride * h );
+	for ( int y = 0; y < h; y += 1 )
+	{
+		raw[y * stride] = 0;
+		pack_row( frame, y, &raw[y * stride + 1] );
+	}
+
+	uLongf                     size = compressBound( (uLong)raw.size() );
+	std::vector<unsigned char> data( size );
+	if ( compress2(&data[0], &size, raw.data(), (uLong)raw.size(),
+	               level) != Z_OK )
+	{
+		errno = ENOMEM;
+		return false;
+	}
+
+	return fwrite( signature, 1, 8, file ) == 8 &&
+	       write_chunk( file, "IHDR", ihdr, sizeof(ihdr) ) &&
+	       write_chunk( file, "IDAT", &data[0], size ) &&
+	       write_chunk( file, "IEND", NULL, 0 );
+}
+
+bool write_image( const Framebuffer& frame, const char* filename )
+{
+	size_t length = strlen( filename );
+	bool   png    = length >= 4 && !strcmp( filename + length - 4, ".png" );
+
+	FILE* file = fopen( filename, "wb" );
+	if ( !file )
+	{
+		return false;
+	}
+
+	bool ok = png ? write_png( frame, file ) : write_ppm( frame, file );
+
+	return fclose( file ) == 0 && ok;
+}
@@ -0,0 +1,26 @@
+#ifndef CS488_IMAGE_HPP
+#define CS488_IMAGE_HPP
+
+#include <stdio.h>
+#include "raster.hpp"
+
+
+// Writing software frames out as images. Alpha is dropped: every format
+// gets 8-bit RGB, rows from the top. Each function returns false if the
+// writing failed, with errno telling why.
+
+// Binary PPM (P6)
+bool write_ppm  ( const Framebuffer& frame, FILE* file );
+
+// PNG, deflated by zlib at "level" (0 to 9; wireframes on a flat
+// background compress well even at the fastest level, 1)
+bool write_png  ( const Framebuffer& frame, FILE* file, int level = 1 );
+
+// The bare pixels, 3 bytes each, with no header; a sequence of these is
+// the rawvideo rgb24 stream that video tools read
+bool write_raw  ( const Framebuffer& frame, FILE* file );
+
+// Writes a PPM or PNG file, by the extension of "filename"
+bool write_image( const Framebuffer& frame, const char* filename );
+
+#endif
@@ -1,6 +1,9 @@
 #include <gtkmm.h>
 #include <gtkglmm.h>
+#include <stdlib.h>
+#include <string.h>
 #include "appwindow.hpp"
+#include "draw.hpp"
 
 int main(int argc, char** argv)
 {
@@ -10,8 +13,40 @@ int main(int argc, char** argv)
 	// Initialize OpenGL
 	Gtk::GL::init(argc, argv);
 
+	// The arguments left after GTK's: -soft to draw with the software
+	// rasterizer, -record and a file to record the session into, -mesh
+	// and an OBJ or PLY file to draw in place of the cubes, -scene and a
+	// scene cache to draw instead, and the number of cubes
+	int         cubes  = 1;
+	const char* record = NULL;
+	const char* mesh   = NULL;
+	const char* scene  = NULL;
+	for ( int i = 1; i < argc; i += 1 )
+	{
+		if ( !strcmp(argv[i], "-soft") )
+		{
+			draw_set_software( true );
+		}
+		else if ( !strcmp(argv[i], "-record") && i + 1 < argc )
+		{
+			record = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-mesh") && i + 1 < argc )
+		{
+			mesh = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-scene") && i + 1 < argc )
+		{
+			scene = argv[++i];
+		}
+		else
+		{
+			cubes = atoi( argv[i] );
+		}
+	}
+
 	// Construct our (only) window
-	AppWindow window;
+	AppWindow window( cubes, record, mesh, scene );
 
 	// And run the application!
 	Gtk::Main::run(window);
@@ -0,0 +1,89 @@
+#include "mapfile.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// mmap can't map an empty file; those get this instead
+static const char s_empty[1] = { 0 };
+
+MappedFile::MappedFile()
+	: m_data  ( NULL )
+	, m_size  ( 0 )
+	, m_mapped( false )
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open( const char* filename, std::string& error )
+{
+	close();
+
+	int fd = ::open( filename, O_RDONLY );
+	if ( fd < 0 )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		return false;
+	}
+
+	struct stat info;
+	if ( fstat(fd, &info) != 0 )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		::close( fd );
+		return false;
+	}
+	if ( !S_ISREG(info.st_mode) )
+	{
+		error = std::string( filename ) + ": not a regular file";
+		::close( fd );
+		return false;
+	}
+
+	if ( info.st_size == 0 )
+	{
+		m_data = s_empty;
+		::close( fd );
+		return true;
+	}
+
+	void* data = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE,
+	                   fd, 0 );
+	int   saved = errno;
+	::close( fd );
+
+	if ( data == MAP_FAILED )
+	{
+		error = std::string( filename ) + ": " + strerror( saved );
+		return false;
+	}
+
+	// Readers go through all of it, so start reading it in now
+	madvise( data, (size_t)info.st_size, MADV_WILLNEED );
+
+	m_data   = (const char*)data;
+	m_size   = (size_t)info.st_size;
+	m_mapped = true;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if ( m_mapped )
+	{
+		munmap( (void*)m_data, m_size );
+	}
+
+	m_data   = NULL;
+	m_size   = 0;
+	m_mapped = false;
+}
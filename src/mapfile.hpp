@@ -0,0 +1,39 @@
+#ifndef CS488_MAPFILE_HPP
+#define CS488_MAPFILE_HPP
+
+#include <stddef.h>
+#include <string>
+
+
+// A file mapped read-only into memory, so that large inputs can be parsed
+// in place without being copied into buffers first. The pages are read in
+// by the kernel as they are first touched.
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Maps "filename", unmapping whatever was mapped before. Returns false,
+	// with the reason in "error", if the file can't be opened or mapped.
+	bool        open ( const char* filename, std::string& error );
+	void        close();
+
+	bool        is_open() const { return m_data != NULL; }
+
+	// The contents of the file; not terminated, so parsers must stop at
+	// data() + size()
+	const char* data () const { return m_data; }
+	size_t      size () const { return m_size; }
+
+private:
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+
+	const char* m_data;
+	size_t      m_size;
+	// Whether m_data came from mmap rather than being an empty file's
+	// placeholder
+	bool        m_mapped;
+};
+
+#endif
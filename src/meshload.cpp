@@ -0,0 +1,1153 @@
+#include "meshload.hpp"
+#include "mapfile.hpp"
+#include "stats.hpp"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <charconv>
+#include <vector>
+
+
+// Bytes of text in each parse task, and records of a fixed-size binary
+// PLY element
+static const size_t s_chunkBytes   = 1 << 20;
+static const size_t s_chunkRecords = 1 << 16;
+
+// What one parse task produced, in file order
+struct Chunk {
+	std::vector<float>    xs;
+	std::vector<float>    ys;
+	std::vector<float>    zs;
+	// Pairs of vertex indices, one pair per edge, into all the vertices of
+	// the file
+	std::vector<int64_t>  edges;
+	// Where in "edges" OBJ relative indices were stored; those count from
+	// the first vertex of the chunk until the chunks are put together
+	std::vector<size_t>   relative;
+
+	// The first thing wrong, and the offset in the file it was found at
+	const char*           error;
+	size_t                error_at;
+
+	Chunk() : error( NULL ), error_at( 0 ) {}
+};
+
+static inline bool is_space( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skip_space( const char* p, const char* end )
+{
+	while ( p < end && is_space(*p) )
+	{
+		p += 1;
+	}
+
+	return p;
+}
+
+// The newline ending the line at p, or end if it is the last
+static inline const char* line_end( const char* p, const char* end )
+{
+	const char* newline = (const char*)memchr( p, '\n', end - p );
+
+	return newline ? newline : end;
+}
+
+// Parses the number at p, after any blanks, into "value" and moves p past
+// it. The number has to end at a blank or at the end of the line.
+template <typename T>
+static bool parse_number( const char*& p, const char* end, T& value )
+{
+	p = skip_space( p, end );
+	if ( p < end && *p == '+' )
+	{
+		p += 1;
+	}
+
+	std::from_chars_result result = std::from_chars( p, end, value );
+	if ( result.ec != std::errc() ||
+	     ( result.ptr < end && !is_space(*result.ptr) ) )
+	{
+		return false;
+	}
+
+	p = result.ptr;
+	return true;
+}
+
+static void fail( Chunk& chunk, const char* file, const char* at,
+                  const char* error )
+{
+	if ( !chunk.error )
+	{
+		chunk.error    = error;
+		chunk.error_at = at - file;
+	}
+}
+
+// Appends the edges around a polygon, or along a polyline if it isn't
+// "closed". "relative" flags the corners that are OBJ relative indices,
+// if any are.
+static void add_polygon( Chunk& chunk, const std::vector<int64_t>& corners,
+                         const char* relative, bool closed )
+{
+	size_t n = corners.size();
+
+	for ( size_t i = 0; i < n; i += 1 )
+	{
+		size_t j = i + 1;
+		if ( j == n )
+		{
+			if ( !closed || n < 3 )
+			{
+				break;
+			}
+			j = 0;
+		}
+
+		if ( relative && relative[i] )
+		{
+			chunk.relative.push_back( chunk.edges.size() );
+		}
+		chunk.edges.push_back( corners[i] );
+		if ( relative && relative[j] )
+		{
+			chunk.relative.push_back( chunk.edges.size() );
+		}
+		chunk.edges.push_back( corners[j] );
+	}
+}
+
+// Cuts [begin, end) into pieces of about s_chunkBytes, each but the last
+// ending just after a newline. Returns the boundaries, begin and end
+// included.
+static std::vector<const char*> split_lines( const char* begin,
+                                             const char* end )
+{
+	std::vector<const char*> cuts( 1, begin );
+
+	const char* p = begin;
+	while ( (size_t)( end - p ) > s_chunkBytes )
+	{
+		const char* newline = (const char*)memchr( p + s_chunkBytes, '\n',
+		                                           end - p - s_chunkBytes );
+		if ( !newline )
+		{
+			break;
+		}
+		p = newline + 1;
+		cuts.push_back( p );
+	}
+	if ( cuts.back() != end )
+	{
+		cuts.push_back( end );
+	}
+
+	return cuts;
+}
+
+// OBJ
+
+static void parse_obj( const char* file, const char* begin, const char* end,
+                       Chunk& chunk )
+{
+	std::vector<int64_t> corners;
+	std::vector<char>    relative;
+
+	for ( const char* line = begin; line < end && !chunk.error; )
+	{
+		const char* stop = line_end( line, end );
+		const char* p    = skip_space( line, stop );
+		const char* next = stop < end ? stop + 1 : end;
+
+		if ( stop - p < 2 || !is_space(p[1]) )
+		{
+			line = next;
+			continue;
+		}
+
+		if ( p[0] == 'v' )
+		{
+			float x, y, z;
+			p += 1;
+			if ( parse_number(p, stop, x) && parse_number(p, stop, y) &&
+			     parse_number(p, stop, z) )
+			{
+				chunk.xs.push_back( x );
+				chunk.ys.push_back( y );
+				chunk.zs.push_back( z );
+			}
+			else
+			{
+				fail( chunk, file, line, "expected: v x y z" );
+			}
+		}
+		else if ( p[0] == 'f' || p[0] == 'l' )
+		{
+			bool closed = p[0] == 'f';
+			p += 1;
+
+			corners.clear();
+			relative.clear();
+			while ( ( p = skip_space(p, stop) ) < stop )
+			{
+				long long index;
+				std::from_chars_result result = std::from_chars( p, stop,
+				                                                 index );
+				if ( result.ec != std::errc() || index == 0 )
+				{
+					break;
+				}
+
+				// Past any texture and normal indices
+				p = result.ptr;
+				while ( p < stop && !is_space(*p) )
+				{
+					p += 1;
+				}
+
+				if ( index > 0 )
+				{
+					corners.push_back( index - 1 );
+					relative.push_back( 0 );
+				}
+				else
+				{
+					corners.push_back( (int64_t)chunk.xs.size() + index );
+					relative.push_back( 1 );
+				}
+			}
+
+			if ( p < stop || corners.size() < 2 )
+			{
+				fail( chunk, file, line, closed ? "bad face" : "bad line" );
+			}
+			else
+			{
+				add_polygon( chunk, corners, &relative[0], closed );
+			}
+		}
+
+		line = next;
+	}
+}
+
+static bool parse_obj_file( const char* data, size_t size,
+                            Scheduler& scheduler, std::vector<Chunk>& chunks,
+                            std::string& )
+{
+	std::vector<const char*> cuts = split_lines( data, data + size );
+
+	chunks.resize( cuts.size() - 1 );
+	scheduler.run( chunks.size(), [&]( size_t c, size_t )
+	{
+		parse_obj( data, cuts[c], cuts[c + 1], chunks[c] );
+	} );
+
+	return true;
+}
+
+// PLY
+
+enum PlyType {
+	PLY_INT8,
+	PLY_UINT8,
+	PLY_INT16,
+	PLY_UINT16,
+	PLY_INT32,
+	PLY_UINT32,
+	PLY_FLOAT32,
+	PLY_FLOAT64,
+	PLY_NONE
+};
+
+static const size_t s_plySize[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static PlyType ply_type( const char* name )
+{
+	static const char* names[][2] = {
+		{ "char",  "int8"    }, { "uchar",  "uint8"   },
+		{ "short", "int16"   }, { "ushort", "uint16"  },
+		{ "int",   "int32"   }, { "uint",   "uint32"  },
+		{ "float", "float32" }, { "double", "float64" }
+	};
+
+	for ( int t = PLY_INT8; t < PLY_NONE; t += 1 )
+	{
+		if ( !strcmp(name, names[t][0]) || !strcmp(name, names[t][1]) )
+		{
+			return (PlyType)t;
+		}
+	}
+
+	return PLY_NONE;
+}
+
+struct PlyProperty {
+	std::string name;
+	PlyType     type;
+	// Type of the length of a list property; PLY_NONE for a single value
+	PlyType     count;
+};
+
+struct PlyElement {
+	std::string              name;
+	size_t                   count;
+	std::vector<PlyProperty> properties;
+
+	// Properties the mesh is made from, -1 where there are none: the
+	// position of a vertex, the corners of a face, the ends of an edge
+	int                      x, y, z;
+	int                      corners;
+	int                      vertex1, vertex2;
+
+	// Bytes in each record in a binary file, 0 if it has lists and so
+	// varies
+	size_t                   record;
+};
+
+struct PlyHeader {
+	enum Format { ASCII, LITTLE, BIG };
+
+	Format                  format;
+	std::vector<PlyElement> elements;
+	// Offset of the first record
+	size_t                  body;
+};
+
+static int find_property( const PlyElement& element, const char* name,
+                          bool list )
+{
+	for ( size_t i = 0; i < element.properties.size(); i += 1 )
+	{
+		const PlyProperty& property = element.properties[i];
+		if ( property.name == name &&
+		     ( property.count != PLY_NONE ) == list )
+		{
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+static bool parse_ply_header( const char* data, size_t size,
+                              PlyHeader& header, std::string& error )
+{
+	const char* end    = data + size;
+	bool        format = false;
+
+	header.elements.clear();
+
+	for ( const char* line = data; ; )
+	{
+		if ( line >= end )
+		{
+			error = "no end_header";
+			return false;
+		}
+
+		const char* stop = line_end( line, end );
+		std::string text( line, stop );
+		line = stop < end ? stop + 1 : end;
+
+		// Up to five words are all any line needs
+		char words[5][64];
+		int  count = sscanf( text.c_str(), "%63s %63s %63s %63s %63s",
+		                     words[0], words[1], words[2], words[3],
+		                     words[4] );
+		if ( count <= 0 )
+		{
+			continue;
+		}
+
+		if ( !strcmp(words[0], "end_header") )
+		{
+			header.body = line - data;
+			break;
+		}
+		else if ( !strcmp(words[0], "format") && count >= 2 )
+		{
+			format = true;
+			if ( !strcmp(words[1], "ascii") )
+			{
+				header.format = PlyHeader::ASCII;
+			}
+			else if ( !strcmp(words[1], "binary_little_endian") )
+			{
+				header.format = PlyHeader::LITTLE;
+			}
+			else if ( !strcmp(words[1], "binary_big_endian") )
+			{
+				header.format = PlyHeader::BIG;
+			}
+			else
+			{
+				error = "unknown format " + std::string( words[1] );
+				return false;
+			}
+		}
+		else if ( !strcmp(words[0], "element") && count == 3 )
+		{
+			PlyElement element;
+			element.name  = words[1];
+			element.count = strtoul( words[2], NULL, 10 );
+			header.elements.push_back( element );
+		}
+		else if ( !strcmp(words[0], "property") && !header.elements.empty() )
+		{
+			// property type name, or property list count type name
+			PlyProperty property;
+			property.type  = PLY_NONE;
+			property.count = PLY_NONE;
+			if ( count == 3 )
+			{
+				property.name = words[2];
+				property.type = ply_type( words[1] );
+			}
+			else if ( count == 5 && !strcmp(words[1], "list") )
+			{
+				property.name  = words[4];
+				property.count = ply_type( words[2] );
+				property.type  = property.count != PLY_NONE
+				                     ? ply_type( words[3] ) : PLY_NONE;
+			}
+
+			if ( property.type == PLY_NONE )
+			{
+				error = "bad property: " + text;
+				return false;
+			}
+			header.elements.back().properties.push_back( property );
+		}
+		else if ( !strcmp(words[0], "ply") || !strcmp(words[0], "comment") ||
+		          !strcmp(words[0], "obj_info") )
+		{
+			continue;
+		}
+		else
+		{
+			error = "bad header line: " + text;
+			return false;
+		}
+	}
+
+	if ( !format )
+	{
+		error = "no format";
+		return false;
+	}
+
+	for ( size_t e = 0; e < header.elements.size(); e += 1 )
+	{
+		PlyElement& element = header.elements[e];
+
+		element.x = element.y = element.z = element.corners = -1;
+		element.vertex1 = element.vertex2 = -1;
+		if ( element.name == "vertex" )
+		{
+			element.x = find_property( element, "x", false );
+			element.y = find_property( element, "y", false );
+			element.z = find_property( element, "z", false );
+			if ( element.x < 0 || element.y < 0 || element.z < 0 )
+			{
+				error = "vertices without x, y and z";
+				return false;
+			}
+		}
+		else if ( element.name == "face" )
+		{
+			element.corners = find_property( element, "vertex_indices", true );
+			if ( element.corners < 0 )
+			{
+				element.corners = find_property( element, "vertex_index",
+				                                 true );
+			}
+		}
+		else if ( element.name == "edge" )
+		{
+			element.vertex1 = find_property( element, "vertex1", false );
+			element.vertex2 = find_property( element, "vertex2", false );
+		}
+
+		element.record = 0;
+		for ( size_t i = 0; i < element.properties.size(); i += 1 )
+		{
+			const PlyProperty& property = element.properties[i];
+			if ( property.count != PLY_NONE )
+			{
+				element.record = 0;
+				break;
+			}
+			element.record += s_plySize[property.type];
+		}
+	}
+
+	return true;
+}
+
+// Adds what a record of "element" makes to the chunk: "values" holds its
+// single-valued properties, "corners" the list of face corners if it has
+// one
+static void add_record( Chunk& chunk, const PlyElement& element,
+                        const std::vector<double>& values,
+                        const std::vector<int64_t>& corners )
+{
+	if ( element.x >= 0 )
+	{
+		chunk.xs.push_back( (float)values[element.x] );
+		chunk.ys.push_back( (float)values[element.y] );
+		chunk.zs.push_back( (float)values[element.z] );
+	}
+	else if ( element.corners >= 0 )
+	{
+		add_polygon( chunk, corners, NULL, true );
+	}
+	else if ( element.vertex1 >= 0 && element.vertex2 >= 0 )
+	{
+		chunk.edges.push_back( (int64_t)values[element.vertex1] );
+		chunk.edges.push_back( (int64_t)values[element.vertex2] );
+	}
+}
+
+// Parses the ascii records starting at line "first" of the body, counting
+// from 0, in [begin, end)
+static void parse_ply_ascii( const char* file, const PlyHeader& header,
+                             size_t first, const char* begin,
+                             const char* end, Chunk& chunk )
+{
+	// The element line "first" is a record of, and its number in it
+	size_t e = 0, record = first;
+	while ( e < header.elements.size() &&
+	        record >= header.elements[e].count )
+	{
+		record -= header.elements[e].count;
+		e += 1;
+	}
+
+	std::vector<double>  values;
+	std::vector<int64_t> corners;
+
+	for ( const char* line = begin;
+	      line < end && e < header.elements.size() && !chunk.error; )
+	{
+		const PlyElement& element = header.elements[e];
+		const char*       stop    = line_end( line, end );
+		const char*       p       = line;
+
+		values.resize( element.properties.size() );
+		corners.clear();
+
+		bool ok = true;
+		for ( size_t i = 0; i < element.properties.size() && ok; i += 1 )
+		{
+			const PlyProperty& property = element.properties[i];
+
+			if ( property.count == PLY_NONE )
+			{
+				ok = parse_number( p, stop, values[i] );
+				continue;
+			}
+
+			size_t count = 0;
+			ok = parse_number( p, stop, count );
+			for ( size_t k = 0; k < count && ok; k += 1 )
+			{
+				double value;
+				ok = parse_number( p, stop, value );
+				if ( ok && (int)i == element.corners )
+				{
+					corners.push_back( (int64_t)value );
+				}
+			}
+		}
+
+		if ( !ok || skip_space(p, stop) < stop )
+		{
+			fail( chunk, file, line, "bad record" );
+		}
+		else
+		{
+			add_record( chunk, element, values, corners );
+		}
+
+		line = stop < end ? stop + 1 : end;
+		if ( ++record == element.count )
+		{
+			record = 0;
+			do
+			{
+				e += 1;
+			} while ( e < header.elements.size() &&
+			          header.elements[e].count == 0 );
+		}
+	}
+}
+
+static double read_value( const char* p, PlyType type, bool swap )
+{
+	unsigned char bytes[8];
+	size_t        size = s_plySize[type];
+
+	memcpy( bytes, p, size );
+	if ( swap )
+	{
+		std::reverse( bytes, bytes + size );
+	}
+
+	switch ( type )
+	{
+	case PLY_INT8:    { int8_t   v; memcpy( &v, bytes, 1 ); return v; }
+	case PLY_UINT8:   { uint8_t  v; memcpy( &v, bytes, 1 ); return v; }
+	case PLY_INT16:   { int16_t  v; memcpy( &v, bytes, 2 ); return v; }
+	case PLY_UINT16:  { uint16_t v; memcpy( &v, bytes, 2 ); return v; }
+	case PLY_INT32:   { int32_t  v; memcpy( &v, bytes, 4 ); return v; }
+	case PLY_UINT32:  { uint32_t v; memcpy( &v, bytes, 4 ); return v; }
+	case PLY_FLOAT32: { float    v; memcpy( &v, bytes, 4 ); return v; }
+	default:          { double   v; memcpy( &v, bytes, 8 ); return v; }
+	}
+}
+
+// Parses "records" binary records of "element" from p on, adding them to
+// "chunk" if it is given. Returns the end of the last record, or NULL if
+// the file ends first or, when "record" isn't 0, a record isn't "record"
+// bytes long.
+static const char* parse_ply_binary( const PlyHeader& header,
+                                     const PlyElement& element,
+                                     const char* p, const char* end,
+                                     size_t records, size_t record,
+                                     Chunk* chunk )
+{
+	bool swap = ( header.format == PlyHeader::BIG );
+
+	std::vector<double>  values( element.properties.size() );
+	std::vector<int64_t> corners;
+
+	for ( size_t r = 0; r < records; r += 1 )
+	{
+		const char* start = p;
+
+		corners.clear();
+		for ( size_t i = 0; i < element.properties.size(); i += 1 )
+		{
+			const PlyProperty& property = element.properties[i];
+			size_t             size     = s_plySize[property.type];
+
+			if ( property.count == PLY_NONE )
+			{
+				if ( (size_t)( end - p ) < size )
+				{
+					return NULL;
+				}
+				values[i] = chunk ? read_value( p, property.type, swap )
+				                  : 0.0;
+				p += size;
+				continue;
+			}
+
+			if ( (size_t)( end - p ) < s_plySize[property.count] )
+			{
+				return NULL;
+			}
+			size_t count = (size_t)read_value( p, property.count, swap );
+			p += s_plySize[property.count];
+			if ( (size_t)( end - p ) / size < count )
+			{
+				return NULL;
+			}
+
+			if ( chunk && (int)i == element.corners )
+			{
+				for ( size_t k = 0; k < count; k += 1 )
+				{
+					corners.push_back(
+					    (int64_t)read_value(p + k * size, property.type, swap) );
+				}
+			}
+			p += count * size;
+		}
+
+		if ( record && (size_t)( p - start ) != record )
+		{
+			return NULL;
+		}
+		if ( chunk )
+		{
+			add_record( *chunk, element, values, corners );
+		}
+	}
+
+	return p;
+}
+
+// A run of binary records for a task to parse: "record" is the size all
+// of them are guessed to be, or 0 if it isn't a guess
+struct BinaryTask {
+	const PlyElement* element;
+	const char*       start;
+	size_t            records;
+	size_t            record;
+};
+
+// Splits the binary records after "body" into tasks, guessing the size
+// of the records of elements with lists from the first of each if
+// "guess" is set
+static bool plan_ply_binary( const PlyHeader& header, const char* body,
+                             const char* end, bool guess,
+                             std::vector<BinaryTask>& tasks,
+                             std::string& error )
+{
+	tasks.clear();
+
+	const char* p = body;
+	for ( size_t e = 0; e < header.elements.size(); e += 1 )
+	{
+		const PlyElement& element = header.elements[e];
+		bool              wanted  = element.x >= 0 || element.corners >= 0 ||
+		                            element.vertex1 >= 0;
+		size_t            record  = element.record;
+		bool              guessed = false;
+
+		if ( record == 0 && guess && element.count > 0 )
+		{
+			const char* next = parse_ply_binary( header, element, p, end, 1, 0,
+			                                     NULL );
+			if ( next && (size_t)( end - p ) / ( next - p ) >= element.count )
+			{
+				record  = next - p;
+				guessed = true;
+			}
+		}
+
+		if ( record > 0 )
+		{
+			if ( (size_t)( end - p ) / record < element.count )
+			{
+				error = "file ends in the " + element.name + " records";
+				return false;
+			}
+			for ( size_t r = 0; wanted && r < element.count;
+			      r += s_chunkRecords )
+			{
+				BinaryTask task = { &element, p + r * record,
+				                    std::min( s_chunkRecords, element.count - r ),
+				                    guessed ? record : 0 };
+				tasks.push_back( task );
+			}
+			p += element.count * record;
+			continue;
+		}
+
+		if ( wanted )
+		{
+			BinaryTask task = { &element, p, element.count, 0 };
+			tasks.push_back( task );
+		}
+		if ( e + 1 < header.elements.size() )
+		{
+			p = parse_ply_binary( header, element, p, end, element.count, 0,
+			                      NULL );
+			if ( !p )
+			{
+				error = "file ends in the " + element.name + " records";
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool parse_ply_file( const char* data, size_t size,
+                            Scheduler& scheduler, std::vector<Chunk>& chunks,
+                            std::string& error )
+{
+	PlyHeader header;
+	if ( !parse_ply_header(data, size, header, error) )
+	{
+		return false;
+	}
+
+	const char* body = data + header.body;
+	const char* end  = data + size;
+
+	if ( header.format == PlyHeader::ASCII )
+	{
+		// Count the lines of every piece first, to know which record each
+		// piece starts at
+		std::vector<const char*> cuts = split_lines( body, end );
+		std::vector<size_t>      first( cuts.size(), 0 );
+
+		chunks.resize( cuts.size() - 1 );
+		scheduler.run( chunks.size(), [&]( size_t c, size_t )
+		{
+			size_t lines = 0;
+			for ( const char* p = cuts[c]; p < cuts[c + 1]; p += 1 )
+			{
+				p = (const char*)memchr( p, '\n', cuts[c + 1] - p );
+				if ( !p )
+				{
+					break;
+				}
+				lines += 1;
+			}
+			first[c + 1] = lines;
+		} );
+		for ( size_t c = 1; c < first.size(); c += 1 )
+		{
+			first[c] += first[c - 1];
+		}
+
+		scheduler.run( chunks.size(), [&]( size_t c, size_t )
+		{
+			parse_ply_ascii( data, header, first[c], cuts[c], cuts[c + 1],
+			                 chunks[c] );
+		} );
+
+		return true;
+	}
+
+	// Binary. Elements are parsed by tasks of s_chunkRecords records
+	// wherever the records are all the same size: always for those without
+	// lists, and for the rest if every record is the size of the first,
+	// as when faces are all triangles or all quads. That is only a guess
+	// at first, which the tasks check record by record; if it turns out
+	// wrong, elements with lists are parsed again as one task each.
+	std::vector<BinaryTask> tasks;
+	for ( int guess = 1; guess >= 0; guess -= 1 )
+	{
+		if ( !plan_ply_binary(header, body, end, guess != 0, tasks, error) )
+		{
+			return false;
+		}
+
+		std::vector<char> wrong( tasks.size(), 0 );
+		chunks.clear();
+		chunks.resize( tasks.size() );
+		scheduler.run( tasks.size(), [&]( size_t t, size_t )
+		{
+			const BinaryTask& task = tasks[t];
+			if ( parse_ply_binary(header, *task.element, task.start, end,
+			                      task.records, task.record, &chunks[t]) )
+			{
+				return;
+			}
+
+			if ( task.record )
+			{
+				wrong[t] = 1;
+			}
+			else
+			{
+				fail( chunks[t], data, task.start, "file ends in a record" );
+			}
+		} );
+
+		if ( std::find(wrong.begin(), wrong.end(), 1) == wrong.end() )
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+// Putting the pieces together
+
+static inline uint32_t float_bits( float value )
+{
+	// The same bits for -0 and +0
+	value += 0.0f;
+
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof(bits) );
+	return bits;
+}
+
+// Merges vertices at the same position, keeping the first of each in
+// place and moving the rest up behind it. Fills "remap" with the new
+// index of every old one and returns how many are left.
+static size_t merge_vertices( std::vector<float>& xs, std::vector<float>& ys,
+                              std::vector<float>& zs, std::vector<int>& remap )
+{
+	size_t count = xs.size();
+	size_t size  = 16;
+	while ( size < 2 * count )
+	{
+		size *= 2;
+	}
+
+	// Open addressing, by linear probing, over the vertices kept so far
+	std::vector<int> table( size, -1 );
+	size_t           kept = 0;
+
+	remap.resize( count );
+	for ( size_t i = 0; i < count; i += 1 )
+	{
+		uint32_t x = float_bits( xs[i] );
+		uint32_t y = float_bits( ys[i] );
+		uint32_t z = float_bits( zs[i] );
+		uint32_t h = x * 0x9e3779b1u ^ y * 0x85ebca77u ^ z * 0xc2b2ae3du;
+		h ^= h >> 15;
+
+		size_t slot = h & ( size - 1 );
+		while ( table[slot] >= 0 )
+		{
+			int k = table[slot];
+			if ( float_bits(xs[k]) == x && float_bits(ys[k]) == y &&
+			     float_bits(zs[k]) == z )
+			{
+				break;
+			}
+			slot = ( slot + 1 ) & ( size - 1 );
+		}
+
+		if ( table[slot] < 0 )
+		{
+			xs[kept]    = xs[i];
+			ys[kept]    = ys[i];
+			zs[kept]    = zs[i];
+			table[slot] = (int)kept;
+			kept += 1;
+		}
+		remap[i] = table[slot];
+	}
+
+	xs.resize( kept );
+	ys.resize( kept );
+	zs.resize( kept );
+
+	return kept;
+}
+
+// Builds the mesh out of the parsed chunks
+static bool assemble( std::vector<Chunk>& chunks, Scheduler& scheduler,
+                      const Colour& colour, Mesh& mesh, std::string& error,
+                      MeshLoadStats& stats )
+{
+	// Where each chunk's vertices go
+	std::vector<size_t> base( chunks.size() + 1, 0 );
+	for ( size_t c = 0; c < chunks.size(); c += 1 )
+	{
+		base[c + 1] = base[c] + chunks[c].xs.size();
+		stats.edges_read += chunks[c].edges.size() / 2;
+	}
+	size_t count = base.back();
+	if ( count > (size_t)INT_MAX )
+	{
+		error = "too many vertices";
+		return false;
+	}
+
+	std::vector<float> xs( count ), ys( count ), zs( count );
+	scheduler.run( chunks.size(), [&]( size_t c, size_t )
+	{
+		Chunk& chunk = chunks[c];
+
+		for ( size_t i = 0; i < chunk.relative.size(); i += 1 )
+		{
+			chunk.edges[chunk.relative[i]] += base[c];
+		}
+		for ( size_t i = 0; i < chunk.edges.size(); i += 1 )
+		{
+			if ( chunk.edges[i] < 0 || chunk.edges[i] >= (int64_t)count )
+			{
+				chunk.error = "vertex index out of range";
+				break;
+			}
+		}
+
+		std::copy( chunk.xs.begin(), chunk.xs.end(), xs.begin() + base[c] );
+		std::copy( chunk.ys.begin(), chunk.ys.end(), ys.begin() + base[c] );
+		std::copy( chunk.zs.begin(), chunk.zs.end(), zs.begin() + base[c] );
+		std::vector<float>().swap( chunk.xs );
+		std::vector<float>().swap( chunk.ys );
+		std::vector<float>().swap( chunk.zs );
+	} );
+
+	for ( size_t c = 0; c < chunks.size(); c += 1 )
+	{
+		if ( chunks[c].error )
+		{
+			error = chunks[c].error;
+			return false;
+		}
+	}
+
+	std::vector<int> remap;
+	stats.vertices_read = count;
+	stats.vertices      = merge_vertices( xs, ys, zs, remap );
+
+	// Every edge in terms of the merged vertices, smaller index first;
+	// the ones that collapsed to a point are left out
+	scheduler.run( chunks.size(), [&]( size_t c, size_t )
+	{
+		std::vector<int64_t>& edges = chunks[c].edges;
+
+		for ( size_t i = 0; i < edges.size(); i += 2 )
+		{
+			int a = remap[edges[i]];
+			int b = remap[edges[i + 1]];
+			edges[i]     = std::min( a, b );
+			edges[i + 1] = std::max( a, b );
+		}
+	} );
+
+	// Then the edges bucketed by their first index, which takes two passes
+	// rather than the dozens of a sort, leaving only the short runs of
+	// second indices of each bucket to sort and take the repeats out of
+	std::vector<int> start( stats.vertices + 1, 0 );
+	for ( size_t c = 0; c < chunks.size(); c += 1 )
+	{
+		const std::vector<int64_t>& edges = chunks[c].edges;
+		for ( size_t i = 0; i < edges.size(); i += 2 )
+		{
+			if ( edges[i] != edges[i + 1] )
+			{
+				start[edges[i] + 1] += 1;
+			}
+		}
+	}
+	for ( size_t v = 0; v < stats.vertices; v += 1 )
+	{
+		start[v + 1] += start[v];
+	}
+
+	std::vector<int> seconds( start.back() );
+	std::vector<int> fill( start.begin(), start.end() - 1 );
+	for ( size_t c = 0; c < chunks.size(); c += 1 )
+	{
+		std::vector<int64_t>& edges = chunks[c].edges;
+		for ( size_t i = 0; i < edges.size(); i += 2 )
+		{
+			if ( edges[i] != edges[i + 1] )
+			{
+				seconds[fill[edges[i]]++] = (int)edges[i + 1];
+			}
+		}
+		std::vector<int64_t>().swap( edges );
+	}
+
+	Mesh result;
+	result.edges.reserve( seconds.size() * 2 );
+	for ( size_t v = 0; v < stats.vertices; v += 1 )
+	{
+		std::vector<int>::iterator begin = seconds.begin() + start[v];
+		std::vector<int>::iterator end   = seconds.begin() + start[v + 1];
+		std::sort( begin, end );
+		end = std::unique( begin, end );
+
+		for ( ; begin != end; ++begin )
+		{
+			result.edges.push_back( (int)v );
+			result.edges.push_back( *begin );
+		}
+	}
+
+	result.xs.swap( xs );
+	result.ys.swap( ys );
+	result.zs.swap( zs );
+	result.palette.assign( 1, colour );
+	result.colours.assign( result.edge_count(), 0 );
+	stats.edges = result.edge_count();
+
+	mesh = std::move( result );
+	return true;
+}
+
+void MeshLoadStats::report( FILE* file, const char* filename ) const
+{
+	fprintf( file, "%s: %lu vertices, %lu edges (%lu, %lu in the file), "
+	         "%.1f MB in %.1f ms: %.0f MB/s (map %.1f, parse %.1f, merge "
+	         "%.1f ms)\n", filename, (unsigned long)vertices,
+	         (unsigned long)edges, (unsigned long)vertices_read,
+	         (unsigned long)edges_read, bytes * 1e-6, total_ns * 1e-6,
+	         mb_per_sec(), map_ns * 1e-6, parse_ns * 1e-6, merge_ns * 1e-6 );
+}
+
+// Number of the line "offset" is on, counting from 1
+static size_t line_number( const char* data, size_t offset )
+{
+	return std::count( data, data + offset, '\n' ) + 1;
+}
+
+bool load_mesh( const char* filename, Mesh& mesh, const Colour& colour,
+                Scheduler& scheduler, std::string& error,
+                MeshLoadStats* stats )
+{
+	MeshLoadStats local;
+	MeshLoadStats& s = stats ? *stats : local;
+	memset( &s, 0, sizeof(s) );
+
+	double start = stats_now_ns();
+
+	MappedFile file;
+	if ( !file.open(filename, error) )
+	{
+		return false;
+	}
+	s.bytes  = file.size();
+	s.map_ns = stats_now_ns() - start;
+
+	const char* data = file.data();
+	size_t      size = file.size();
+	const char* dot  = strrchr( filename, '.' );
+
+	bool ply;
+	if ( dot && !strcasecmp(dot, ".ply") )
+	{
+		ply = true;
+	}
+	else if ( dot && !strcasecmp(dot, ".obj") )
+	{
+		ply = false;
+	}
+	else
+	{
+		ply = size >= 4 && !memcmp( data, "ply", 3 ) &&
+		      ( data[3] == '\n' || data[3] == '\r' );
+	}
+
+	std::vector<Chunk> chunks;
+	std::string        what;
+	bool ok = ply ? parse_ply_file( data, size, scheduler, chunks, what )
+	              : parse_obj_file( data, size, scheduler, chunks, what );
+	if ( !ok )
+	{
+		error = std::string( filename ) + ": " + what;
+		return false;
+	}
+
+	double parsed = stats_now_ns();
+	s.parse_ns = parsed - start - s.map_ns;
+
+	for ( size_t c = 0; c < chunks.size(); c += 1 )
+	{
+		if ( chunks[c].error )
+		{
+			char where[32];
+			snprintf( where, sizeof(where), ":%lu: ",
+			          (unsigned long)line_number(data, chunks[c].error_at) );
+			error = std::string( filename ) + where + chunks[c].error;
+			return false;
+		}
+	}
+
+	if ( !assemble(chunks, scheduler, colour, mesh, what, s) )
+	{
+		error = std::string( filename ) + ": " + what;
+		return false;
+	}
+
+	s.merge_ns = stats_now_ns() - parsed;
+	s.total_ns = stats_now_ns() - start;
+
+	return true;
+}
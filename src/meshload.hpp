@@ -0,0 +1,61 @@
+#ifndef CS488_MESHLOAD_HPP
+#define CS488_MESHLOAD_HPP
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include "scene.hpp"
+#include "scheduler.hpp"
+
+
+// Loading wireframes from Wavefront OBJ and PLY files.
+//
+// The file is memory-mapped and cut into chunks at line boundaries, which
+// are parsed as tasks on a scheduler straight out of the mapping, with no
+// per-line allocation. Every polygon becomes the edges around it, and OBJ
+// polylines and PLY edge elements their own edges. Vertices at the same
+// position are then merged, and each edge is kept only once whichever way
+// round and however many polygons share it, so the mesh comes out ready
+// for the batch transform path with no repeated work in it.
+//
+// OBJ: v, f and l statements, with negative (relative) indices and any
+// texture and normal indices, which are ignored. PLY: ascii and binary
+// of either byte order, with the vertex positions in x, y and z, faces in
+// vertex_indices (or vertex_index) and edges in vertex1 and vertex2.
+
+// What loading a mesh took
+struct MeshLoadStats {
+	// Size of the file
+	size_t bytes;
+	// Vertices and edges in the file, and left after merging
+	size_t vertices_read;
+	size_t edges_read;
+	size_t vertices;
+	size_t edges;
+	// Mapping the file, parsing it, and merging; the total includes
+	// building the mesh from the result
+	double map_ns;
+	double parse_ns;
+	double merge_ns;
+	double total_ns;
+
+	// Throughput from start to finish, in megabytes (10^6) per second
+	double mb_per_sec() const
+	{
+		return total_ns > 0.0 ? bytes * 1e3 / total_ns : 0.0;
+	}
+
+	// Writes a line saying what was loaded from "filename" and how fast
+	void   report    ( FILE* file, const char* filename ) const;
+};
+
+// Replaces "mesh" with the wireframe in "filename", every edge of it in
+// "colour". The format is picked by the extension, .obj or .ply, or by
+// the PLY magic if neither matches. Returns false, with the reason in
+// "error", if the file can't be read or is malformed; "mesh" is left as
+// it was then.
+bool load_mesh( const char* filename, Mesh& mesh, const Colour& colour,
+                Scheduler& scheduler, std::string& error,
+                MeshLoadStats* stats = NULL );
+
+#endif
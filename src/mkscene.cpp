@@ -0,0 +1,148 @@
+// Scene cache converter: loads an OBJ or PLY wireframe (see meshload.hpp)
+// and writes it out as a scene file (see scenefile.hpp), which ./a2,
+// ./render and ./replay open with -scene in place of parsing the mesh.
+//
+// The mesh is fitted to the unit cube, as -mesh does, unless -nofit is
+// given. With -cubes the file also holds that many instances of it on the
+// viewer's grid; without, it holds none and the viewer lays its own cubes
+// out. The file is opened and checked once written, and the time the
+// open took is printed.
+//
+// -check opens an existing scene file, checks all of it and says what
+// is in it.
+//
+// Usage: ./mkscene [-cubes n] [-nofit] input output
+//        ./mkscene -check file
+
+#include "meshload.hpp"
+#include "scenefile.hpp"
+#include "stats.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+
+static void usage( const char* name )
+{
+	fprintf( stderr, "Usage: %s [-cubes n] [-nofit] input output\n"
+	         "       %s -check file\n", name, name );
+	exit( 1 );
+}
+
+// Opens and checks "filename", saying how long each took and what is in
+// it
+static bool check( const char* name, const char* filename )
+{
+	SceneFile   file;
+	std::string error;
+
+	double start  = stats_now_ns();
+	bool   ok     = file.open( filename, error );
+	double opened = stats_now_ns();
+	ok = ok && file.verify( error );
+	double verified = stats_now_ns();
+
+	if ( !ok )
+	{
+		fprintf( stderr, "%s: %s\n", name, error.c_str() );
+		return false;
+	}
+
+	size_t vertices = 0, edges = 0;
+	for ( size_t m = 0; m < file.mesh_count(); m += 1 )
+	{
+		vertices += file.mesh( m ).vertex_count;
+		edges    += file.mesh( m ).edge_count;
+	}
+
+	fprintf( stderr, "%s: %lu mesh(es), %lu vertices, %lu edges, "
+	         "%lu instance(s), %.1f MB: opened in %.3f ms, checked in "
+	         "%.1f ms\n", filename, (unsigned long)file.mesh_count(),
+	         (unsigned long)vertices, (unsigned long)edges,
+	         (unsigned long)file.instance_count(), file.bytes() * 1e-6,
+	         ( opened - start ) * 1e-6, ( verified - opened ) * 1e-6 );
+
+	return true;
+}
+
+int main( int argc, char** argv )
+{
+	int         cubes  = 0;
+	bool        fit    = true;
+	const char* input  = NULL;
+	const char* output = NULL;
+
+	if ( argc == 3 && !strcmp(argv[1], "-check") )
+	{
+		return check( argv[0], argv[2] ) ? 0 : 1;
+	}
+
+	for ( int i = 1; i < argc; i += 1 )
+	{
+		if ( !strcmp(argv[i], "-cubes") && i + 1 < argc )
+		{
+			cubes = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-nofit") )
+		{
+			fit = false;
+		}
+		else if ( argv[i][0] != '-' && !input )
+		{
+			input = argv[i];
+		}
+		else if ( argv[i][0] != '-' && !output )
+		{
+			output = argv[i];
+		}
+		else
+		{
+			usage( argv[0] );
+		}
+	}
+	if ( !input || !output )
+	{
+		usage( argv[0] );
+	}
+
+	Scheduler     scheduler;
+	Mesh          mesh;
+	MeshLoadStats stats;
+	std::string   error;
+	if ( !load_mesh(input, mesh, Colour(1.0, 1.0, 1.0), scheduler, error,
+	                &stats) )
+	{
+		fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+		return 1;
+	}
+	stats.report( stderr, input );
+
+	if ( fit )
+	{
+		fit_mesh( mesh );
+	}
+
+	Scene scene;
+	int   m = scene.add_mesh( mesh );
+	if ( cubes == 1 )
+	{
+		scene.add_instance( m, Vector3D() );
+	}
+	else if ( cubes > 1 )
+	{
+		scene.add_grid( m, cubes, 3.0, 0.35 );
+	}
+
+	double start = stats_now_ns();
+	if ( !SceneFile::write(output, scene, error) )
+	{
+		fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+		return 1;
+	}
+	fprintf( stderr, "%s: written in %.1f ms\n", output,
+	         ( stats_now_ns() - start ) * 1e-6 );
+
+	return check( argv[0], output ) ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include "motion.hpp"
+
+
+MotionQueue::MotionQueue()
+	: m_pending ( false )
+	, m_mode    ( Pipeline::MODELROTATE )
+	, m_button1 ( false )
+	, m_button2 ( false )
+	, m_button3 ( false )
+	, m_delta   ( 0.0 )
+	, m_factor  ( 1.0 )
+	, m_steps   ( 0 )
+	, m_received( 0 )
+	, m_applied ( 0 )
+{
+}
+
+void MotionQueue::add( Pipeline& pipeline, Pipeline::Mode mode,
+                       bool button1, bool button2, bool button3,
+                       double delta )
+{
+	m_received += 1;
+
+	if ( m_pending && ( mode    != m_mode    || button1 != m_button1 ||
+	                    button2 != m_button2 || button3 != m_button3 ) )
+	{
+		apply( pipeline );
+	}
+
+	if ( !m_pending )
+	{
+		m_pending = true;
+		m_mode    = mode;
+		m_button1 = button1;
+		m_button2 = button2;
+		m_button3 = button3;
+		m_delta   = 0.0;
+		m_factor  = 1.0;
+		m_steps   = 0;
+	}
+
+	// Pipeline::motion scales by 1 + delta / 100 per movement
+	m_delta  += delta;
+	m_factor *= 1.0 + delta / 100.0;
+	m_steps  += 1;
+
+	// Rotations about several axes are taken one at a time
+	bool rotate = mode == Pipeline::VIEWROTATE ||
+	              mode == Pipeline::MODELROTATE;
+	if ( rotate && (int)button1 + (int)button2 + (int)button3 > 1 )
+	{
+		apply( pipeline );
+	}
+}
+
+bool MotionQueue::apply( Pipeline& pipeline )
+{
+	if ( !m_pending )
+	{
+		return false;
+	}
+
+	// Scaling by the product of the factors, as one movement
+	double delta = m_delta;
+	if ( m_mode == Pipeline::MODELSCALE && m_steps > 1 )
+	{
+		delta = ( m_factor - 1.0 ) * 100.0;
+	}
+
+	pipeline.motion( m_mode, m_button1, m_button2, m_button3, delta );
+	m_pending  = false;
+	m_applied += 1;
+
+	return true;
+}
+
+void MotionQueue::discard()
+{
+	// The movements in it count as merged, since none were applied
+	m_pending = false;
+}
@@ -0,0 +1,56 @@
+#ifndef CS488_MOTION_HPP
+#define CS488_MOTION_HPP
+
+#include "pipeline.hpp"
+
+
+// Pointer movements waiting to be applied to a Pipeline, so that a mouse
+// reporting far more often than the display refreshes costs one update
+// per frame instead of one per event. Consecutive movements in the same
+// mode with the same buttons held are merged into one, which is what a
+// mouse reporting less often would have sent; a change of mode or buttons
+// applies what came before it first.
+//
+// Merging adds up the deltas, except for scaling, where each movement
+// scales by a factor and the factors are multiplied instead. Rotations
+// with two or more buttons held turn about several axes in turn, which
+// doesn't commute, so those are applied one by one as they come.
+class MotionQueue {
+public:
+	MotionQueue();
+
+	// Queues a movement of "delta" pixels, as taken by Pipeline::motion
+	void          add     ( Pipeline& pipeline, Pipeline::Mode mode,
+	                        bool button1, bool button2, bool button3,
+	                        double delta );
+
+	// Applies the queued movement to the pipeline. Returns false if there
+	// was none.
+	bool          apply   ( Pipeline& pipeline );
+
+	// Forgets the queued movement without applying it
+	void          discard ();
+
+	bool          pending () const { return m_pending; }
+
+	// Movements queued, and the number of them that were folded into
+	// another instead of being applied on their own
+	unsigned long received() const { return m_received; }
+	unsigned long merged  () const { return m_received - m_applied; }
+
+private:
+	// The movement so far: the sum of the deltas of the movements in it,
+	// and the product of the scale factors they stand for
+	bool           m_pending;
+	Pipeline::Mode m_mode;
+	bool           m_button1, m_button2, m_button3;
+	double         m_delta;
+	double         m_factor;
+	unsigned long  m_steps;
+
+	// Counters
+	unsigned long  m_received;
+	unsigned long  m_applied;
+};
+
+#endif
@@ -0,0 +1,1139 @@
+#include "pipeline.hpp"
+#include "a2.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include "edgeclip.hpp"
+#include "scenefile.hpp"
+#include "session.hpp"
+#include "simd.hpp"
+#include "transform.hpp"
+
+
+LineList::LineList()
+{
+	clear();
+}
+
+void LineList::clear()
+{
+	m_lines.clear();
+	m_colours.clear();
+	m_colours.push_back( Colour(0.0) );
+}
+
+void LineList::set_colour( const Colour& colour )
+{
+	const Colour& last = m_colours.back();
+	if ( last.R() != colour.R() || last.G() != colour.G() ||
+	     last.B() != colour.B() )
+	{
+		m_colours.push_back( colour );
+	}
+}
+
+void LineList::add( const Point2D& p, const Point2D& q )
+{
+	Line line = { p, q, m_colours.size() - 1 };
+	m_lines.push_back( line );
+}
+
+void LineList::append( const LineList& other )
+{
+	size_t colour = (size_t)-1;
+
+	m_lines.reserve( m_lines.size() + other.size() );
+	for ( size_t i = 0; i < other.size(); i += 1 )
+	{
+		const Line& line = other[i];
+		if ( line.colour != colour )
+		{
+			colour = line.colour;
+			set_colour( other.colour(colour) );
+		}
+		add( line.p, line.q );
+	}
+}
+
+Point3D project( const Matrix4x4& projection, const Point3D& point )
+{
+	// Project the point into the viewing plane using algorithm described in
+	// course notes
+	Point3D point_p = projection * point;
+
+	return Point3D( point_p[0] / point[2],
+					point_p[1] / point[2],
+			        point_p[2] / point[2] );
+}
+
+Point2D normalize( const Point2D viewport[4], const Point3D& point )
+{
+	// Normalize the point to the coordinates used in the viewing window using
+	// algorithm described in course notes
+	double z = point[2];
+
+	return Point2D( (point[0] / z + 1.5) *
+			        (viewport[2][0] - viewport[0][0]) /
+			         3 + viewport[0][0],
+					(point[1] / z + 1.5) *
+					(viewport[2][1] - viewport[0][1]) /
+					 3 + viewport[0][1] );
+}
+
+bool clip_line( const Matrix4x4& projection, double near, double far,
+                const Point2D viewport[4], Point3D left, Point3D right,
+                Point2D& p, Point2D& q )
+{
+	// Clip to the near plane using algorithm described in course notes
+	double clipNL = ( left  - Point3D(0.0, 0.0, near) ).dot(
+			Vector3D(0.0, 0.0, 1.0) );
+	double clipNR = ( right - Point3D(0.0, 0.0, near) ).dot(
+			Vector3D(0.0, 0.0, 1.0) );
+	if ( clipNL < 0.0 && clipNR < 0.0 )
+	{
+		return false;
+	}
+	if ( clipNL < 0.0 || clipNR < 0.0 )
+	{
+		double t = clipNL / ( clipNL - clipNR );
+		if ( clipNL < 0.0 )
+		{
+			left = left + t * ( right - left );
+		}
+		else
+		{
+			right = left + t * ( right - left );
+		}
+	}
+
+	// Clip to the far plane using algorithm described in course notes
+	double clipFL = ( left  - Point3D(0.0, 0.0, far) ).dot(
+			Vector3D(0.0, 0.0, -1.0) );
+	double clipFR = ( right - Point3D(0.0, 0.0, far) ).dot(
+			Vector3D(0.0, 0.0, -1.0) );
+	if ( clipFL < 0.0 && clipFR < 0.0 )
+	{
+		return false;
+	}
+	if ( clipFL < 0.0 || clipFR < 0.0 )
+	{
+		double t = clipFL / ( clipFL - clipFR );
+		if ( clipFL < 0.0 )
+		{
+			left = left + t * ( right - left );
+		}
+		else
+		{
+			right = left + t * ( right - left );
+		}
+	}
+
+	// First we project, then normalize each of the points
+	Point2D nleft  = normalize( viewport, project(projection, left)  );
+	Point2D nright = normalize( viewport, project(projection, right) );
+
+	// Next, we clip to the viewing cube (the viewport) using algorithm
+	// described in course notes
+	bool draw = true;
+	for ( int i = 0; i < 4; i++ )
+	{
+		double clipVL, clipVR;
+		switch( i )
+		{
+		case 0:
+			clipVL = nleft[1]  - viewport[0][1];
+			clipVR = nright[1] - viewport[0][1];
+			break;
+		case 1:
+			clipVL = -1.0 * ( nleft[0]  - viewport[1][0] );
+			clipVR = -1.0 * ( nright[0] - viewport[1][0] );
+			break;
+		case 2:
+			clipVL = -1.0 * ( nleft[1]  - viewport[2][1] );
+			clipVR = -1.0 * ( nright[1] - viewport[2][1] );
+			break;
+		case 3:
+			clipVL = nleft[0]  - viewport[3][0];
+			clipVR = nright[0] - viewport[3][0];
+			break;
+		default:
+			clipVL = -1.0;
+			clipVR = -1.0;
+			break;
+		}
+
+		if ( clipVL < 0.0 && clipVR < 0.0 )
+		{
+			draw = false;
+		}
+		else
+		{
+			if ( clipVL < 0.0 || clipVR < 0.0 )
+			{
+				double t = clipVL / ( clipVL - clipVR );
+				if ( clipVL < 0.0 )
+				{
+					nleft[0]  = nleft[0] + t * ( nright[0] - nleft[0] );
+					nleft[1]  = nleft[1] + t * ( nright[1] - nleft[1] );
+				}
+				else
+				{
+					nright[0] = nleft[0] + t * ( nright[0] - nleft[0] );
+					nright[1] = nleft[1] + t * ( nright[1] - nleft[1] );
+				}
+			}
+		}
+	}
+
+	p = nleft;
+	q = nright;
+
+	return draw;
+}
+
+Clipper::Clipper( const View& view )
+	: m_view( view )
+{
+	for ( int i = 0; i < 3; i += 1 )
+	{
+		for ( int j = 0; j < 4; j += 1 )
+		{
+			m_proj[i][j] = view.projection[i][j];
+		}
+	}
+
+	m_x0 = view.viewport[0][0];
+	m_y0 = view.viewport[0][1];
+	m_sx = ( view.viewport[2][0] - view.viewport[0][0] ) / 3;
+	m_sy = ( view.viewport[2][1] - view.viewport[0][1] ) / 3;
+
+	// An empty viewport maps everything onto its edge, which the
+	// homogeneous tests below can't express
+	m_always = ( m_sx > 0.0 && m_sy > 0.0 ) ? 0 : UNSURE;
+
+	// The planes in viewing coordinates: near and far in z, the sides of
+	// the viewport as in outcode, -1.5 W <= X <= 1.5 W and the same for Y,
+	// and W itself, each written as something that is positive inside
+	double planes[PLANES][4];
+	for ( int j = 0; j < 4; j += 1 )
+	{
+		double n = ( j == 2 ) ? 1.0 : 0.0;
+		planes[0][j] =  n;
+		planes[1][j] = -n;
+		planes[2][j] = 1.5 * m_proj[2][j] + m_proj[0][j];
+		planes[3][j] = 1.5 * m_proj[2][j] - m_proj[0][j];
+		planes[4][j] = 1.5 * m_proj[2][j] + m_proj[1][j];
+		planes[5][j] = 1.5 * m_proj[2][j] - m_proj[1][j];
+		planes[6][j] = m_proj[2][j];
+	}
+	planes[0][3] = -view.near;
+	planes[1][3] =  view.far;
+
+	// Bring them back to world coordinates through the viewing transform,
+	// scaled to measure true distances
+	const Matrix4x4& v = view.viewing;
+	for ( int p = 0; p < PLANES; p += 1 )
+	{
+		double world[4];
+		for ( int j = 0; j < 4; j += 1 )
+		{
+			world[j] = planes[p][0] * v[0][j] + planes[p][1] * v[1][j] +
+			           planes[p][2] * v[2][j];
+		}
+		world[3] += planes[p][3];
+
+		double length = sqrt( world[0] * world[0] + world[1] * world[1] +
+		                      world[2] * world[2] );
+		for ( int j = 0; j < 4; j += 1 )
+		{
+			m_planes[p][j] = length > 0.0 ? world[j] / length : 0.0;
+		}
+	}
+}
+
+Clipper::Containment Clipper::classify( const Sphere& sphere ) const
+{
+	const Point3D& c = sphere.centre;
+
+	double d[PLANES], r[PLANES];
+	for ( int p = 0; p < PLANES; p += 1 )
+	{
+		const double* plane = m_planes[p];
+		d[p] = plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3];
+		r[p] = sphere.radius;
+	}
+
+	return classify( d, r );
+}
+
+Clipper::Containment Clipper::classify( const Point3D& lo,
+                                        const Point3D& hi ) const
+{
+	double c[3], e[3];
+	for ( int a = 0; a < 3; a += 1 )
+	{
+		c[a] = 0.5 * ( lo[a] + hi[a] );
+		e[a] = 0.5 * ( hi[a] - lo[a] );
+	}
+
+	// The box reaches along each plane's normal by its half extents
+	// projected onto it
+	double d[PLANES], r[PLANES];
+	for ( int p = 0; p < PLANES; p += 1 )
+	{
+		const double* plane = m_planes[p];
+		d[p] = plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3];
+		r[p] = fabs( plane[0] ) * e[0] + fabs( plane[1] ) * e[1] +
+		       fabs( plane[2] ) * e[2];
+	}
+
+	return classify( d, r );
+}
+
+Clipper::Containment Clipper::classify( const double d[PLANES],
+                                        const double r[PLANES] ) const
+{
+	// The same tests as Clipper::clip, on the whole volume: it is gone if
+	// it is beyond the near or far plane, or beyond a side of the viewport
+	// while entirely in front of W = 0, where the sides mean something
+	if ( d[0] < -r[0] || d[1] < -r[1] )
+	{
+		return OUTSIDE;
+	}
+
+	bool trusted = d[6] > r[6] && m_always == 0;
+	bool inside  = trusted && d[0] > r[0] && d[1] > r[1];
+	for ( int p = 2; p < 6; p += 1 )
+	{
+		if ( trusted && d[p] < -r[p] )
+		{
+			return OUTSIDE;
+		}
+		inside = inside && d[p] > r[p];
+	}
+
+	return inside ? INSIDE : STRADDLES;
+}
+
+int Clipper::outcode( double x, double y, double z ) const
+{
+	int code = m_always;
+
+	if ( z < m_view.near ) code |= NEAR;
+	if ( z > m_view.far  ) code |= FAR;
+
+	// The window coordinates are ( X / W + 1.5 ) * size / 3 + origin, so
+	// for W > 0 the point is inside the viewport when -1.5 W <= X <= 1.5 W
+	double X = m_proj[0][0] * x + m_proj[0][1] * y + m_proj[0][2] * z +
+	           m_proj[0][3];
+	double Y = m_proj[1][0] * x + m_proj[1][1] * y + m_proj[1][2] * z +
+	           m_proj[1][3];
+	double W = m_proj[2][0] * x + m_proj[2][1] * y + m_proj[2][2] * z +
+	           m_proj[2][3];
+
+	if ( !( W > 0.0 ) )
+	{
+		return code | UNSURE;
+	}
+
+	if ( X < -1.5 * W ) code |= LEFT;
+	if ( X >  1.5 * W ) code |= RIGHT;
+	if ( Y < -1.5 * W ) code |= TOP;
+	if ( Y >  1.5 * W ) code |= BOTTOM;
+
+	return code;
+}
+
+Point2D Clipper::project( double x, double y, double z ) const
+{
+	double X = m_proj[0][0] * x + m_proj[0][1] * y + m_proj[0][2] * z +
+	           m_proj[0][3];
+	double Y = m_proj[1][0] * x + m_proj[1][1] * y + m_proj[1][2] * z +
+	           m_proj[1][3];
+	double W = m_proj[2][0] * x + m_proj[2][1] * y + m_proj[2][2] * z +
+	           m_proj[2][3];
+
+	return Point2D( ( X / W + 1.5 ) * m_sx + m_x0,
+	                ( Y / W + 1.5 ) * m_sy + m_y0 );
+}
+
+bool Clipper::clip( const Point3D& left, const Point3D& right,
+                    Point2D& p, Point2D& q ) const
+{
+	int codeL = outcode( left[0],  left[1],  left[2]  );
+	int codeR = outcode( right[0], right[1], right[2] );
+
+	// Trivially accept
+	if ( ( codeL | codeR ) == 0 )
+	{
+		p = project( left[0],  left[1],  left[2]  );
+		q = project( right[0], right[1], right[2] );
+		return true;
+	}
+
+	// Trivially reject. The viewport planes are linear in viewing
+	// coordinates, so a line with both ends outside one of them stays
+	// outside after near and far clipping, as long as W > 0 at both ends.
+	int common = codeL & codeR;
+	if ( ( common & ( NEAR | FAR ) ) ||
+	     ( common && !( ( codeL | codeR ) & UNSURE ) ) )
+	{
+		return false;
+	}
+
+	return clip_line( m_view.projection, m_view.near, m_view.far,
+	                  m_view.viewport, left, right, p, q );
+}
+
+// A mesh whose vertices are waiting in MeshBuffers,
+// from index "first" on, and whether it is known to be inside the view
+// volume
+struct PendingMesh {
+	MeshView mesh;
+	size_t   first;
+	bool     inside;
+};
+
+// Vertices gathered before they are projected and their edges clipped.
+// Small meshes are batched up to this many so the projection runs over
+// full vectors and the stage timers are read once per batch, not per mesh.
+static const size_t BATCH_VERTICES = 4096;
+
+// Scratch space for the vertices of the meshes waiting to be clipped,
+// transformed to viewing coordinates and then projected, along with where
+// the time went. The time since "mark" has not been charged to any stage
+// yet.
+struct MeshBuffers {
+	MeshBuffers()
+		: count( 0 )
+		, stats( RenderStats() )
+		, mark ( stats_now_ns() )
+	{
+	}
+
+	std::vector<float>       x, y, z;
+	size_t                   count;
+	std::vector<PendingMesh> meshes;
+	ProjectedPoints          points;
+	RenderStats              stats;
+	double                   mark;
+};
+
+// Charges the time since the mark to "stage", and moves the mark up
+static inline void lap( MeshBuffers& trans, double& stage )
+{
+	double now = stats_now_ns();
+	stage     += now - trans.mark;
+	trans.mark = now;
+}
+
+// Projects the waiting vertices, each once, then clips the edges of the
+// waiting meshes and appends the survivors to "lines", charging the time
+// before to the transform stage and the rest to the clip stage
+static void flush( const Clipper& clipper, MeshBuffers& trans,
+                   LineList& lines )
+{
+	if ( trans.meshes.empty() )
+	{
+		return;
+	}
+
+	lap( trans, trans.stats.transform_ns );
+	project_points( clipper, &trans.x[0], &trans.y[0], &trans.z[0],
+	                trans.count, trans.points );
+	for ( size_t m = 0; m < trans.meshes.size(); m += 1 )
+	{
+		const PendingMesh& pending = trans.meshes[m];
+		trans.stats.edges += pending.mesh.edge_count;
+		trans.stats.drawn += clip_mesh( clipper, pending.mesh, pending.first,
+		                                pending.inside, &trans.x[0],
+		                                &trans.y[0], &trans.z[0],
+		                                trans.points, lines );
+	}
+	lap( trans, trans.stats.clip_ns );
+
+	trans.meshes.clear();
+	trans.count = 0;
+}
+
+// Transforms the vertices of the mesh by m, which includes the viewing
+// transform, and queues the mesh for clipping, or with "inside" only for
+// drawing. Full batches are projected and clipped on the way; call flush
+// for the rest.
+static void render_mesh( const Clipper& clipper, const MeshView& mesh,
+                         const Matrix4x4f& m, MeshBuffers& trans,
+                         LineList& lines, bool inside = false )
+{
+	size_t n = mesh.vertex_count;
+
+	if ( n == 0 )
+	{
+		return;
+	}
+
+	// Apply the transformations to all the vertices in one go
+	size_t first = trans.count;
+	if ( trans.x.size() < first + n )
+	{
+		size_t size = std::max( BATCH_VERTICES, first + n );
+		trans.x.resize( size );
+		trans.y.resize( size );
+		trans.z.resize( size );
+	}
+	transform_points( m, mesh.xs, mesh.ys, mesh.zs, n,
+	                  &trans.x[first], &trans.y[first], &trans.z[first] );
+
+	PendingMesh pending = { mesh, first, inside };
+	trans.meshes.push_back( pending );
+	trans.count += n;
+
+	if ( trans.count >= BATCH_VERTICES )
+	{
+		flush( clipper, trans, lines );
+	}
+}
+
+// An instance that survived culling, and whether it is known to lie
+// wholly inside the view volume
+struct VisibleInstance {
+	uint32_t instance;
+	uint32_t inside;
+};
+
+static bool by_instance( const VisibleInstance& a, const VisibleInstance& b )
+{
+	return a.instance < b.instance;
+}
+
+// Walks the scene's instance tree, dropping subtrees outside the view
+// volume whole and taking those inside it without further tests; only the
+// instances in leaves across its boundary are tested one by one. Appends
+// the instances left to "visible" in instance order, so they are drawn as
+// they would be without the tree, and counts the rest, and their edges, in
+// "stats".
+static void cull_instances( const Clipper& clipper, const Scene& scene,
+                            std::vector<VisibleInstance>& visible,
+                            RenderStats& stats )
+{
+	const InstanceTree& tree  = scene.tree();
+	const uint32_t*     order = tree.order();
+	size_t              edges = 0;
+
+	stats.instances += scene.instance_count();
+	if ( tree.node_count() == 0 )
+	{
+		return;
+	}
+
+	// Instances are counted in 32 bits, so the tree is under 32 levels deep
+	// and the stack never holds more than one node per level and the root
+	uint32_t stack[64];
+	size_t   depth = 0;
+	stack[depth++] = 0;
+
+	while ( depth > 0 )
+	{
+		const InstanceTree::Node& node = tree.node( stack[--depth] );
+		Clipper::Containment      cull = clipper.classify( node.lo, node.hi );
+
+		if ( cull == Clipper::OUTSIDE )
+		{
+			stats.rejected += node.count;
+			continue;
+		}
+		if ( cull == Clipper::STRADDLES && node.child != 0 )
+		{
+			// Left child on top, to come out in the order of the leaves
+			stack[depth++] = node.child + 1;
+			stack[depth++] = node.child;
+			continue;
+		}
+
+		for ( uint32_t k = node.first; k < node.first + node.count; k += 1 )
+		{
+			uint32_t             i    = order[k];
+			Clipper::Containment mine = cull;
+
+			if ( mine == Clipper::STRADDLES )
+			{
+				mine = clipper.classify( scene.bounds(i) );
+				if ( mine == Clipper::OUTSIDE )
+				{
+					stats.rejected += 1;
+					continue;
+				}
+			}
+			if ( mine == Clipper::INSIDE )
+			{
+				stats.accepted += 1;
+			}
+
+			VisibleInstance v = { i, mine == Clipper::INSIDE };
+			visible.push_back( v );
+			edges += scene.mesh( scene.mesh_of(i) ).edge_count;
+		}
+	}
+
+	// The tree lists instances leaf by leaf; back in instance order, the
+	// lines come out the same as from testing each instance in turn
+	std::sort( visible.begin(), visible.end(), by_instance );
+
+	// The edges of the instances culled, which the clip stage never sees
+	stats.edges += scene.edge_count() - edges;
+}
+
+// Renders visible instances [first, last) into "trans", leaving the last
+// batch unclipped. Those inside the view volume are drawn unclipped.
+static void render_instances( const Clipper& clipper, const Matrix4x4f& viewing,
+                              const Scene& scene,
+                              const VisibleInstance* visible, size_t first,
+                              size_t last, MeshBuffers& trans,
+                              LineList& lines )
+{
+	trans.mark = stats_now_ns();
+
+	for ( size_t v = first; v < last; v += 1 )
+	{
+		uint32_t i = visible[v].instance;
+		render_mesh( clipper, scene.mesh(scene.mesh_of(i)),
+		             viewing * scene.transform(i), trans, lines,
+		             visible[v].inside != 0 );
+	}
+}
+
+// Scenes with fewer visible instances than this aren't worth waking the
+// workers for, and no task gets fewer than this many instances
+static const size_t PARALLEL_INSTANCES = 64;
+// Tasks per worker. Instances straddling the view volume cost more than
+// those inside it, so the work is cut finer than one chunk per worker for
+// the scheduler to even out.
+static const size_t TASKS_PER_WORKER   = 8;
+
+// Culls the scene, then renders what is left on the scheduler, appending
+// to "lines" and adding where the time went to "stats". The culling is
+// charged to the transform stage.
+static void render_parallel( const Clipper& clipper, const Matrix4x4f& viewing,
+                             const Scene& scene, Scheduler& scheduler,
+                             LineList& lines, RenderStats& stats )
+{
+	double                       start = stats_now_ns();
+	std::vector<VisibleInstance> visible;
+
+	cull_instances( clipper, scene, visible, stats );
+	stats.transform_ns += stats_now_ns() - start;
+
+	const VisibleInstance* first = visible.empty() ? NULL : &visible[0];
+	size_t                 n     = visible.size();
+	size_t                 w     = scheduler.workers();
+
+	if ( w == 1 || n < PARALLEL_INSTANCES )
+	{
+		MeshBuffers trans;
+		render_instances( clipper, viewing, scene, first, 0, n, trans, lines );
+		flush( clipper, trans, lines );
+		add_stats( stats, trans.stats );
+		return;
+	}
+
+	size_t chunk = std::max( PARALLEL_INSTANCES, n / ( w * TASKS_PER_WORKER ) );
+	size_t tasks = ( n + chunk - 1 ) / chunk;
+
+	std::vector<MeshBuffers> trans  ( w );
+	std::vector<LineList>    buckets( tasks );
+	scheduler.run( tasks, [&]( size_t t, size_t worker )
+	{
+		render_instances( clipper, viewing, scene, first, t * chunk,
+		                  std::min( n, ( t + 1 ) * chunk ), trans[worker],
+		                  buckets[t] );
+		flush( clipper, trans[worker], buckets[t] );
+	} );
+
+	start = stats_now_ns();
+	for ( size_t t = 0; t < tasks; t += 1 )
+	{
+		lines.append( buckets[t] );
+	}
+	stats.merge_ns += stats_now_ns() - start;
+
+	for ( size_t i = 0; i < w; i += 1 )
+	{
+		add_stats( stats, trans[i].stats );
+	}
+}
+
+void render_scene( const View& view, const Scene& scene, LineList& lines,
+                   RenderStats* stats )
+{
+	double                       start = stats_now_ns();
+	Clipper                      clipper( view );
+	MeshBuffers                  trans;
+	Matrix4x4f                   viewing( view.viewing );
+	std::vector<VisibleInstance> visible;
+
+	cull_instances( clipper, scene, visible, trans.stats );
+	trans.stats.transform_ns += stats_now_ns() - start;
+	render_instances( clipper, viewing, scene,
+	                  visible.empty() ? NULL : &visible[0], 0, visible.size(),
+	                  trans, lines );
+	flush( clipper, trans, lines );
+
+	if ( stats )
+	{
+		*stats         = trans.stats;
+		stats->wall_ns = stats_now_ns() - start;
+	}
+}
+
+void render_scene( const View& view, const Scene& scene, LineList& lines,
+                   Scheduler& scheduler, RenderStats* stats )
+{
+	double      start  = stats_now_ns();
+	RenderStats result = RenderStats();
+
+	render_parallel( Clipper(view), Matrix4x4f(view.viewing), scene, scheduler,
+	                 lines, result );
+
+	if ( stats )
+	{
+		*stats         = result;
+		stats->wall_ns = stats_now_ns() - start;
+	}
+}
+
+Pipeline::Pipeline()
+	: m_worldGnomon( gnomon_mesh(Colour(0.1, 0.1, 1.0)) )
+	, m_modelGnomon( gnomon_mesh(Colour(0.1, 1.0, 0.1)) )
+	, m_cubes      ( 1 )
+	, m_mesh       ( unit_cube_mesh() )
+	, m_file       ( NULL )
+	, m_viewingVersion   ( 0 )
+	, m_projectionVersion( 0 )
+	, m_viewportVersion  ( 0 )
+	, m_selectionVersion ( 0 )
+	, m_frameValid       ( false )
+	, m_frameStats       ( RenderStats() )
+	, m_recorder         ( NULL )
+{
+	reset_state();
+}
+
+void Pipeline::reset()
+{
+	if ( m_recorder )
+	{
+		m_recorder->reset();
+	}
+	reset_state();
+}
+
+void Pipeline::set_recorder( SessionRecorder* recorder )
+{
+	m_recorder = recorder;
+	if ( m_recorder )
+	{
+		m_recorder->cubes( m_cubes );
+	}
+	reset_state();
+}
+
+void Pipeline::reset_state()
+{
+	// Initialize viewport
+	for ( int i = 0; i < 4; i += 1 )
+	{
+		m_view.viewport[i] = ( Point2D() );
+	}
+	m_viewportVersion += 1;
+
+	// Default FOV of 30
+	m_fov  = 30.0;
+
+	// Set the default far and near plane values
+	m_view.near = 2.0;
+	m_view.far  = 20.0;
+	m_projectionVersion += 1;
+
+	// Lay the cubes out again, unless the scene file places its own, and
+	// select all of them
+	m_scene.clear();
+	if ( m_file )
+	{
+		m_file->populate( m_scene );
+	}
+	else
+	{
+		m_scene.add_mesh( m_mesh );
+	}
+
+	if ( m_scene.instance_count() == 0 && m_scene.mesh_count() > 0 )
+	{
+		if ( m_cubes == 1 )
+		{
+			m_scene.add_instance( 0, Vector3D() );
+		}
+		else
+		{
+			m_scene.add_grid( 0, m_cubes, 3.0, 0.35 );
+		}
+	}
+	apply_selection( 0, m_scene.instance_count() );
+
+	// Start off by pushing the cube back into the screen
+	m_viewPosition    = Vector3D( 0.0, 0.0, 8.0 );
+	m_viewOrientation = Quaternion();
+	update_viewing();
+
+	// Initialize the perspective
+	apply_perspective( m_fov, 1, m_view.near, m_view.far );
+}
+
+void Pipeline::set_perspective( double fov,  double aspect,
+                                double near, double far )
+{
+	if ( m_recorder )
+	{
+		m_recorder->perspective( fov, aspect, near, far );
+	}
+	apply_perspective( fov, aspect, near, far );
+}
+
+void Pipeline::apply_perspective( double fov,  double aspect,
+                                  double near, double far )
+{
+	m_view.projection = perspective( fov, aspect, near, far );
+	m_projectionVersion += 1;
+}
+
+void Pipeline::set_cubes( int cubes )
+{
+	if ( m_recorder )
+	{
+		m_recorder->cubes( cubes );
+	}
+	m_cubes = std::max( 1, cubes );
+	reset_state();
+}
+
+void Pipeline::set_mesh( const Mesh& mesh )
+{
+	if ( m_recorder )
+	{
+		m_recorder->reset();
+	}
+	m_mesh = mesh;
+	m_file = NULL;
+	reset_state();
+}
+
+void Pipeline::set_scene_file( const SceneFile* file )
+{
+	if ( m_recorder )
+	{
+		m_recorder->reset();
+	}
+	m_file = file;
+	reset_state();
+}
+
+void Pipeline::select( size_t first, size_t count )
+{
+	if ( m_recorder )
+	{
+		m_recorder->select( first, count );
+	}
+	apply_selection( first, count );
+}
+
+void Pipeline::apply_selection( size_t first, size_t count )
+{
+	size_t instances = m_scene.instance_count();
+
+	m_selFirst = std::min( first, instances );
+	m_selCount = std::min( count, instances - m_selFirst );
+	m_selectionVersion += 1;
+}
+
+void Pipeline::select_all()
+{
+	select( 0, m_scene.instance_count() );
+}
+
+void Pipeline::select_next()
+{
+	size_t instances = m_scene.instance_count();
+
+	if ( m_selCount != 1 )
+	{
+		select( 0, 1 );
+	}
+	else
+	{
+		select( ( m_selFirst + 1 ) % instances, 1 );
+	}
+}
+
+void Pipeline::select_previous()
+{
+	size_t instances = m_scene.instance_count();
+
+	if ( m_selCount != 1 )
+	{
+		select( instances - 1, 1 );
+	}
+	else
+	{
+		select( ( m_selFirst + instances - 1 ) % instances, 1 );
+	}
+}
+
+void Pipeline::set_viewport( double x1, double y1, double x2, double y2 )
+{
+	if ( m_recorder )
+	{
+		m_recorder->viewport( x1, y1, x2, y2 );
+	}
+	m_view.viewport[0] = ( Point2D(x1, y1) );
+	m_view.viewport[1] = ( Point2D(x2, y1) );
+	m_view.viewport[2] = ( Point2D(x2, y2) );
+	m_view.viewport[3] = ( Point2D(x1, y2) );
+	m_viewportVersion += 1;
+}
+
+void Pipeline::set_camera( const Vector3D& position,
+                           const Quaternion& orientation )
+{
+	if ( m_recorder )
+	{
+		m_recorder->camera( position, orientation );
+	}
+	m_viewPosition    = position;
+	m_viewOrientation = orientation.normalize();
+	update_viewing();
+}
+
+void Pipeline::motion( Mode mode, bool button1, bool button2, bool button3,
+                       double delta )
+{
+	if ( m_recorder )
+	{
+		m_recorder->motion( mode, button1, button2, button3, delta );
+	}
+
+	switch ( mode )
+	{
+	case VIEWROTATE:
+		if ( button1 )
+		{
+			m_viewOrientation = m_viewOrientation *
+			                    rotation_quaternion( -delta / 100.0, 'y' );
+		}
+		if ( button2 )
+		{
+			m_viewOrientation = m_viewOrientation *
+			                    rotation_quaternion( -delta / 100.0, 'z' );
+		}
+		if ( button3 )
+		{
+			m_viewOrientation = m_viewOrientation *
+			                    rotation_quaternion( -delta / 100.0, 'x' );
+		}
+		// Rounding would otherwise build up over many small rotations
+		m_viewOrientation = m_viewOrientation.normalize();
+		update_viewing();
+		break;
+	case VIEWTRANSLATE:
+		if ( button1 )
+		{
+			m_viewPosition[0] -= delta / 100.0;
+		}
+		if ( button2 )
+		{
+			m_viewPosition[1] -= delta / 100.0;
+		}
+		if ( button3 )
+		{
+			m_viewPosition[2] -= delta / 100.0;
+		}
+		update_viewing();
+		break;
+	case VIEWPERSPECTIVE:
+		if ( button1 )
+		{
+			m_fov       -= delta / 10.0;
+			apply_perspective( m_fov, 1, m_view.near, m_view.far );
+		}
+		if ( button2 )
+		{
+			m_view.near -= delta / 10.0;
+		}
+		if ( button3 )
+		{
+			m_view.far  -= delta / 10.0;
+		}
+		m_projectionVersion += 1;
+		break;
+	case MODELROTATE:
+		if ( button1 )
+		{
+			apply_rotation( rotation_quaternion(-delta / 100.0, 'y') );
+		}
+		if ( button2 )
+		{
+			apply_rotation( rotation_quaternion(-delta / 100.0, 'z') );
+		}
+		if ( button3 )
+		{
+			apply_rotation( rotation_quaternion(-delta / 100.0, 'x') );
+		}
+		break;
+	case MODELTRANSLATE:
+		if ( button1 )
+		{
+			apply_translation( Vector3D(delta / -100.0, 0.0, 0.0) );
+		}
+		if ( button2 )
+		{
+			apply_translation( Vector3D(0.0, delta / -100.0, 0.0) );
+		}
+		if ( button3 )
+		{
+			apply_translation( Vector3D(0.0, 0.0, delta / -100.0) );
+		}
+		break;
+	case MODELSCALE:
+		if ( button1 )
+		{
+			apply_scale( Vector3D(1.0 + delta / 100.0, 1.0, 1.0) );
+		}
+		if ( button2 )
+		{
+			apply_scale( Vector3D(1.0, 1.0 + delta / 100.0, 1.0) );
+		}
+		if ( button3 )
+		{
+			apply_scale( Vector3D(1.0, 1.0, 1.0 + delta / 100.0) );
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void Pipeline::update_viewing()
+{
+	m_view.viewing = translation( m_viewPosition ) * m_viewOrientation.matrix();
+	m_viewingVersion += 1;
+}
+
+void Pipeline::apply_rotation( const Quaternion& rotation )
+{
+	for ( size_t i = m_selFirst; i < m_selFirst + m_selCount; i += 1 )
+	{
+		m_scene.set_pose( i, m_scene.position(i),
+		                  ( m_scene.orientation(i) * rotation ).normalize() );
+	}
+}
+
+void Pipeline::apply_translation( const Vector3D& displacement )
+{
+	// Moving along the instance's own axes, as right-multiplying its
+	// modelling transform by a translation would
+	for ( size_t i = m_selFirst; i < m_selFirst + m_selCount; i += 1 )
+	{
+		m_scene.set_pose( i, m_scene.position(i) +
+		                     m_scene.orientation(i).rotate(displacement),
+		                  m_scene.orientation(i) );
+	}
+}
+
+void Pipeline::apply_scale( const Vector3D& factors )
+{
+	// Scales are kept per axis, so shrinking by a scaling matrix's inverse
+	// is a division
+	for ( size_t i = m_selFirst; i < m_selFirst + m_selCount; i += 1 )
+	{
+		const Vector3D& s = m_scene.scale( i );
+		m_scene.set_scale( i, Vector3D(s[0] / factors[0], s[1] / factors[1],
+		                               s[2] / factors[2]) );
+	}
+}
+
+const LineList& Pipeline::frame() const
+{
+	if ( m_recorder )
+	{
+		m_recorder->frame();
+	}
+
+	Versions current = versions();
+
+	if ( !m_frameValid || m_frameVersions != current )
+	{
+		render( m_frame, &m_frameStats );
+		m_frameVersions = current;
+		m_frameValid    = true;
+	}
+	else
+	{
+		// The lines are those of the last render, so its counts still
+		// hold; only the time it took is not spent again
+		m_frameStats.transform_ns = 0.0;
+		m_frameStats.clip_ns      = 0.0;
+		m_frameStats.merge_ns     = 0.0;
+		m_frameStats.wall_ns      = 0.0;
+	}
+
+	return m_frame;
+}
+
+Versions Pipeline::versions() const
+{
+	Versions versions;
+
+	versions.viewing    = m_viewingVersion;
+	versions.modelling  = m_scene.modelling_version();
+	versions.scaling    = m_scene.scaling_version();
+	versions.projection = m_projectionVersion;
+	versions.viewport   = m_viewportVersion;
+	versions.selection  = m_selectionVersion;
+
+	return versions;
+}
+
+void Pipeline::render( LineList& lines, RenderStats* stats ) const
+{
+	double      start = stats_now_ns();
+	Clipper     clipper( m_view );
+	MeshBuffers trans;
+	Matrix4x4f  viewing( m_view.viewing );
+
+	lines.clear();
+
+	// Draw the world gnomon, then the modelling gnomon of the selection
+	render_mesh( clipper, m_worldGnomon.view(), viewing, trans, lines );
+	if ( m_selCount > 0 )
+	{
+		Matrix4x4f modelling = to_float( m_scene.modelling(m_selFirst) );
+		render_mesh( clipper, m_modelGnomon.view(), viewing * modelling, trans,
+		             lines );
+	}
+
+	flush( clipper, trans, lines );
+
+	render_parallel( clipper, viewing, m_scene, m_scheduler, lines,
+	                 trans.stats );
+
+	// Draw the viewport
+	const Point2D* viewport = m_view.viewport;
+	lines.set_colour( Colour(0.1, 0.1, 0.1) );
+	lines.add( viewport[0], viewport[1] );
+	lines.add( viewport[1], viewport[2] );
+	lines.add( viewport[2], viewport[3] );
+	lines.add( viewport[3], viewport[0] );
+
+	if ( stats )
+	{
+		*stats         = trans.stats;
+		stats->wall_ns = stats_now_ns() - start;
+	}
+}
@@ -0,0 +1,372 @@
+#ifndef CS488_PIPELINE_HPP
+#define CS488_PIPELINE_HPP
+
+#include <vector>
+#include "algebra.hpp"
+#include "scene.hpp"
+#include "simd.hpp"
+#include "scheduler.hpp"
+#include "stats.hpp"
+
+
+// The geometry pipeline used by the Viewer, kept free of any GTK or GL
+// calls so that it can also be driven headlessly (see bench.cpp). Scenes
+// go in, window-space lines come out.
+
+// Window-space lines produced by the pipeline, in drawing order
+class LineList {
+public:
+	struct Line {
+		Point2D p;
+		Point2D q;
+		// Index of the colour the line is drawn in
+		size_t  colour;
+	};
+
+	LineList();
+
+	// Removes all lines
+	void          clear     ();
+
+	// Sets the colour of the lines added from now on
+	void          set_colour( const Colour& colour );
+
+	// Appends a line from p to q in the current colour
+	void          add       ( const Point2D& p, const Point2D& q );
+
+	// Appends all the lines of "other", in their own colours
+	void          append    ( const LineList& other );
+
+	size_t        size      () const { return m_lines.size(); }
+	const Line&   operator[]( size_t i ) const { return m_lines[i]; }
+	const Colour& colour    ( size_t i ) const { return m_colours[i]; }
+
+private:
+	std::vector<Line>   m_lines;
+	std::vector<Colour> m_colours;
+};
+
+// Camera and viewport parameters for one frame
+struct View {
+	// Transformation matrices
+	Matrix4x4 viewing;
+	Matrix4x4 projection;
+
+	// Clipping planes
+	double    near;
+	double    far;
+
+	// Viewport corners, in window coordinates
+	Point2D   viewport[4];
+};
+
+// Applies projective transform to a point
+Point3D project     ( const Matrix4x4& projection, const Point3D& point );
+
+// Normalizes a point to the viewing window
+Point2D normalize   ( const Point2D viewport[4], const Point3D& point );
+
+// Clips a 3D line in viewing coordinates to the near and far planes,
+// projects it and clips it to the viewport. Returns false if nothing of
+// the line is left to draw, otherwise stores the window coordinates of
+// the visible part in p and q.
+bool    clip_line   ( const Matrix4x4& projection, double near, double far,
+                      const Point2D viewport[4], Point3D left, Point3D right,
+                      Point2D& p, Point2D& q );
+
+class ProjectedPoints;
+
+// The combined clip stage. Each endpoint of a line gets an outcode with
+// one bit per clipping plane it lies outside of: the near and far planes
+// in viewing coordinates, and the four sides of the viewport, tested in
+// homogeneous coordinates before the perspective divide. Lines with both
+// outcodes zero are accepted and projected directly, lines with both
+// endpoints outside the same plane are rejected, and only the rest go
+// through clip_line.
+class Clipper {
+public:
+	// Outcode bits
+	enum {
+		NEAR   = 1 << 0,
+		FAR    = 1 << 1,
+		LEFT   = 1 << 2,
+		RIGHT  = 1 << 3,
+		TOP    = 1 << 4,
+		BOTTOM = 1 << 5,
+		// The viewport bits can't be trusted: the point projects to the
+		// wrong side of the eye, or the viewport is empty
+		UNSURE = 1 << 6
+	};
+
+	// Where a bounding volume lies: wholly outside one of the clipping
+	// planes, wholly inside all of them, or across some
+	enum Containment {
+		OUTSIDE,
+		STRADDLES,
+		INSIDE
+	};
+
+	explicit Clipper( const View& view );
+
+	// Where a sphere in world coordinates lies against the view volume,
+	// taking the viewing transform into account. Spheres behind the eye
+	// or off to one side come out OUTSIDE, and everything in them can be
+	// skipped; everything in an INSIDE one can be drawn unclipped.
+	Containment classify( const Sphere& sphere ) const;
+
+	// The same for the axis-aligned box from lo to hi
+	Containment classify( const Point3D& lo, const Point3D& hi ) const;
+
+	// Outcode of a point in viewing coordinates
+	int     outcode( double x, double y, double z ) const;
+
+	// Window coordinates of a point in viewing coordinates, the same as
+	// normalize( viewport, project(projection, point) )
+	Point2D project( double x, double y, double z ) const;
+
+	// Same as clip_line, using the outcodes to skip the work for lines
+	// that are entirely inside or outside
+	bool    clip   ( const Point3D& left, const Point3D& right,
+	                 Point2D& p, Point2D& q ) const;
+
+private:
+	// The batch projector in edgeclip.cpp runs the same tests on its own
+	friend void project_points( const Clipper& clipper, const float* x,
+	                            const float* y, const float* z, size_t n,
+	                            ProjectedPoints& out );
+
+	// A copy, so a Clipper may outlive the View it was made from
+	View        m_view;
+
+	// First three rows of the projection matrix
+	double      m_proj[3][4];
+
+	// Viewport origin, and a third of its size
+	double      m_x0, m_y0;
+	double      m_sx, m_sy;
+
+	// Outcode bits that apply to every point
+	int         m_always;
+
+	// The clipping planes in world coordinates, as a, b, c, d with
+	// a x + b y + c z + d the distance inside the plane: the six in the
+	// order of the outcode bits, then W = 0, in front of which the
+	// viewport planes can be trusted. A plane that the viewing transform
+	// and projection collapse to nothing has a = b = c = 0, and is never
+	// inside.
+	enum { PLANES = 7 };
+	double      m_planes[PLANES][4];
+
+	// Where a volume lies, given how far inside each plane its centre is
+	// and how far it reaches towards that plane
+	Containment classify( const double distance[PLANES],
+	                      const double reach[PLANES] ) const;
+};
+
+// Transforms, clips and projects every instance in the scene, appending
+// the visible lines to "lines". If "stats" is given, it is set to where
+// the time went.
+void    render_scene( const View& view, const Scene& scene, LineList& lines,
+                      RenderStats* stats = NULL );
+
+// Same as above, with the instances split into chunks that are run as
+// tasks on the scheduler. Each chunk fills a line list of its own, and
+// the lists are appended to "lines" in instance order, so the result is
+// the same.
+void    render_scene( const View& view, const Scene& scene, LineList& lines,
+                      Scheduler& scheduler, RenderStats* stats = NULL );
+
+// Counters bumped whenever the matching part of a Pipeline's state
+// changes, so results derived from it can tell when they are stale
+struct Versions {
+	unsigned long viewing;
+	unsigned long modelling;
+	unsigned long scaling;
+	// Projection matrix and near and far planes
+	unsigned long projection;
+	unsigned long viewport;
+	unsigned long selection;
+};
+
+inline bool operator==( const Versions& a, const Versions& b )
+{
+	return a.viewing    == b.viewing    && a.modelling == b.modelling &&
+	       a.scaling    == b.scaling    &&
+	       a.projection == b.projection && a.viewport  == b.viewport  &&
+	       a.selection  == b.selection;
+}
+
+inline bool operator!=( const Versions& a, const Versions& b )
+{
+	return !( a == b );
+}
+
+class SessionRecorder;
+class SceneFile;
+
+// The state behind the viewer: the camera, a scene of cubes and the
+// selection of them the modelling modes act on, along with the effect of
+// mouse movements on them.
+class Pipeline {
+public:
+	// Interaction modes, in the same order as Viewer::Mode
+	enum Mode {
+		VIEWROTATE,
+		VIEWTRANSLATE,
+		VIEWPERSPECTIVE,
+		MODELROTATE,
+		MODELTRANSLATE,
+		MODELSCALE,
+		VIEWPORT
+	};
+
+	Pipeline();
+
+	// Restore all the transforms and perspective parameters to their
+	// original state. The viewport is left empty.
+	void        reset          ();
+
+	// Set the parameters of the current perspective projection using
+	// the semantics of gluPerspective().
+	void        set_perspective( double fov, double aspect,
+	                             double near, double far );
+
+	// Set the number of cubes in the scene and reset. One cube is drawn as
+	// the unit cube; more are laid out on a grid.
+	void        set_cubes      ( int cubes );
+
+	// Draw "mesh" in place of the unit cube, in every instance, and reset.
+	// The mesh isn't logged by set_recorder(); a session recorded with one
+	// has to be replayed with the same one.
+	void        set_mesh       ( const Mesh& mesh );
+
+	// Draw the scene in "file" instead, its meshes drawn in place, or go
+	// back to the mesh if it is NULL, and reset. If the file has no
+	// instances, its first mesh is laid out as the cubes are. The file
+	// has to stay open until another one or NULL is set; like the mesh,
+	// it isn't logged.
+	void        set_scene_file ( const SceneFile* file );
+
+	// Select the "count" instances starting at "first" for the modelling
+	// modes to act on
+	void        select         ( size_t first, size_t count );
+	void        select_all     ();
+	// Select a single instance, following or preceding the current one
+	void        select_next    ();
+	void        select_previous();
+
+	size_t      selection_first() const { return m_selFirst; }
+	size_t      selection_count() const { return m_selCount; }
+
+	// Set the viewport to the rectangle spanned by the two corners
+	void        set_viewport   ( double x1, double y1, double x2, double y2 );
+
+	// Place the camera: the viewing transform becomes a rotation by
+	// "orientation" followed by a translation by "position", as reset()
+	// leaves it with the identity and ( 0, 0, 8 )
+	void        set_camera     ( const Vector3D& position,
+	                             const Quaternion& orientation );
+
+	const Vector3D&   camera_position   () const { return m_viewPosition; }
+	const Quaternion& camera_orientation() const { return m_viewOrientation; }
+
+	// Applies a horizontal mouse movement of "delta" pixels (previous
+	// position minus current one) with the given buttons held down
+	void        motion         ( Mode mode, bool button1, bool button2,
+	                             bool button3, double delta );
+
+	// Replaces the contents of "lines" with everything drawn in a frame,
+	// including the outline of the viewport. If "stats" is given, it is
+	// set to where the time went.
+	void        render         ( LineList& lines,
+	                             RenderStats* stats = NULL ) const;
+
+	// Everything drawn in a frame, as rendered by render(). The lines are
+	// kept and only rendered again once some of the state they depend on
+	// has changed, so redrawing an unchanged frame is a replay.
+	const LineList& frame      () const;
+
+	// Where the time of the last frame() went, and the counts of the lines
+	// it returned. The times are zero if it replayed the frame before.
+	const RenderStats& frame_stats() const { return m_frameStats; }
+
+	// Current versions of the state
+	Versions    versions       () const;
+
+	// Log every change of state and every frame() to "recorder" (see
+	// session.hpp), or stop logging if it is NULL. The pipeline is set to
+	// its original state with the current number of cubes first, and that
+	// is logged too, so the session replays from a known start.
+	void        set_recorder   ( SessionRecorder* recorder );
+
+	const View&  view          () const { return m_view; }
+	const Scene& scene         () const { return m_scene; }
+
+	// The scheduler the scene is rendered on, for its statistics
+	Scheduler&   scheduler     () const { return m_scheduler; }
+
+private:
+	// What reset(), set_perspective() and select() do, without logging
+	// the call; for the calls they are part of
+	void        reset_state    ();
+	void        apply_perspective( double fov, double aspect,
+	                               double near, double far );
+	void        apply_selection( size_t first, size_t count );
+
+	// Recomputes the viewing transform from its position and orientation
+	void        update_viewing ();
+
+	// Turns each instance of the selection about its own axes
+	void        apply_rotation ( const Quaternion& rotation );
+
+	// Moves each instance of the selection along its own axes
+	void        apply_translation( const Vector3D& displacement );
+
+	// Shrinks the scale of the selection by the given factors
+	void        apply_scale    ( const Vector3D& factors );
+
+	// Camera and viewport. The viewing transform is kept as an orientation
+	// followed by a displacement, and composed into m_view on change.
+	View       m_view;
+	Vector3D   m_viewPosition;
+	Quaternion m_viewOrientation;
+
+	// FOV value, default 30
+	double    m_fov;
+
+	// World and modelling gnomons
+	Mesh      m_worldGnomon;
+	Mesh      m_modelGnomon;
+
+	// The cubes, how many of them there are, and what each of them draws,
+	// unless a scene file is drawn instead
+	Scene     m_scene;
+	int       m_cubes;
+	Mesh      m_mesh;
+	const SceneFile* m_file;
+
+	// Selected instances
+	size_t    m_selFirst;
+	size_t    m_selCount;
+
+	// Versions of the parts of the state kept here; the scene keeps its
+	// own
+	unsigned long m_viewingVersion;
+	unsigned long m_projectionVersion;
+	unsigned long m_viewportVersion;
+	unsigned long m_selectionVersion;
+
+	// The last frame rendered by frame(), and the versions it is of
+	mutable LineList m_frame;
+	mutable Versions m_frameVersions;
+	mutable bool     m_frameValid;
+	mutable RenderStats m_frameStats;
+
+	// Threads the scene is rendered on
+	mutable Scheduler m_scheduler;
+
+	// Where changes are logged, if anywhere
+	SessionRecorder*  m_recorder;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "quaternion.hpp"
+
+Matrix4x4 Quaternion::matrix() const
+{
+  double w = v_[0], x = v_[1], y = v_[2], z = v_[3];
+  Matrix4x4 r;
+
+  r[0][0] = 1 - 2*(y*y + z*z);
+  r[0][1] = 2*(x*y - w*z);
+  r[0][2] = 2*(x*z + w*y);
+  r[1][0] = 2*(x*y + w*z);
+  r[1][1] = 1 - 2*(x*x + z*z);
+  r[1][2] = 2*(y*z - w*x);
+  r[2][0] = 2*(x*z - w*y);
+  r[2][1] = 2*(y*z + w*x);
+  r[2][2] = 1 - 2*(x*x + y*y);
+
+  return r;
+}
+
+Quaternion slerp(const Quaternion& a, const Quaternion& b, double t)
+{
+  double d = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+  double sign = 1.0;
+
+  // q and -q are the same rotation; take the one closer to a
+  if(d < 0.0) {
+    d = -d;
+    sign = -1.0;
+  }
+
+  double ka, kb;
+  if(d > 0.9995) {
+    // Nearly parallel: interpolate linearly and renormalize
+    ka = 1.0 - t;
+    kb = t;
+  } else {
+    double theta = acos(d);
+    double s = sin(theta);
+    ka = sin((1.0 - t) * theta) / s;
+    kb = sin(t * theta) / s;
+  }
+  kb *= sign;
+
+  return Quaternion(ka*a[0] + kb*b[0], ka*a[1] + kb*b[1],
+                    ka*a[2] + kb*b[2], ka*a[3] + kb*b[3]).normalize();
+}
@@ -0,0 +1,99 @@
+//---------------------------------------------------------------------------
+//
+// quaternion.hpp
+//
+// Unit quaternions for keeping orientations. Composing two rotations is
+// 16 multiplies instead of the 64 of a 4x4 product, renormalizing after
+// each step keeps the result a rotation however many steps are taken,
+// and four numbers are easy to store and to interpolate between.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_QUATERNION_HPP
+#define CS488_QUATERNION_HPP
+
+#include "algebra.hpp"
+
+class Quaternion
+{
+public:
+  Quaternion()
+  {
+    // The identity rotation
+    v_[0] = 1.0;
+    v_[1] = 0.0;
+    v_[2] = 0.0;
+    v_[3] = 0.0;
+  }
+  Quaternion(double w, double x, double y, double z)
+  {
+    v_[0] = w;
+    v_[1] = x;
+    v_[2] = y;
+    v_[3] = z;
+  }
+  // Rotation of "angle" radians counterclockwise about "axis", which
+  // needn't be unit length
+  static Quaternion axis_angle(const Vector3D& axis, double angle)
+  {
+    Vector3D u = (sin(angle / 2) / axis.length()) * axis;
+    return Quaternion(cos(angle / 2), u[0], u[1], u[2]);
+  }
+
+  // Index 0 is the scalar part, 1 to 3 the vector part
+  double& operator[](size_t idx)
+  {
+    return v_[ idx ];
+  }
+  double operator[](size_t idx) const
+  {
+    return v_[ idx ];
+  }
+
+  double length2() const
+  {
+    return v_[0]*v_[0] + v_[1]*v_[1] + v_[2]*v_[2] + v_[3]*v_[3];
+  }
+
+  Quaternion normalize() const
+  {
+    double r = 1.0 / sqrt(length2());
+    return Quaternion(r*v_[0], r*v_[1], r*v_[2], r*v_[3]);
+  }
+
+  // The inverse, for unit quaternions
+  Quaternion conjugate() const
+  {
+    return Quaternion(v_[0], -v_[1], -v_[2], -v_[3]);
+  }
+
+  // Rotates v, for unit quaternions
+  Vector3D rotate(const Vector3D& v) const
+  {
+    // v + 2 u x (u x v + w v), with u the vector part
+    Vector3D u(v_[1], v_[2], v_[3]);
+    Vector3D t = u.cross(v) + v_[0] * v;
+    return v + 2.0 * u.cross(t);
+  }
+
+  // The rotation as a matrix, for unit quaternions
+  Matrix4x4 matrix() const;
+
+private:
+  double v_[4];
+};
+
+// Rotating by a * b is rotating by b, then by a
+inline Quaternion operator *(const Quaternion& a, const Quaternion& b)
+{
+  return Quaternion(a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3],
+                    a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2],
+                    a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1],
+                    a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0]);
+}
+
+// Spherical linear interpolation from a (t = 0) to b (t = 1), along the
+// shorter arc
+Quaternion slerp(const Quaternion& a, const Quaternion& b, double t);
+
+#endif // CS488_QUATERNION_HPP
@@ -0,0 +1,260 @@
+#include "raster.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+Framebuffer::Framebuffer()
+	: m_width ( 0 )
+	, m_height( 0 )
+{
+}
+
+void Framebuffer::resize( int width, int height )
+{
+	m_width  = std::max( 0, width );
+	m_height = std::max( 0, height );
+	m_pixels.resize( (size_t)m_width * m_height );
+}
+
+void Framebuffer::clear( const Colour& colour )
+{
+	std::fill( m_pixels.begin(), m_pixels.end(), pack(colour) );
+}
+
+void Framebuffer::clear( uint32_t pixel, int left, int top,
+                         int right, int bottom )
+{
+	for ( int y = top; y < bottom; y += 1 )
+	{
+		std::fill( row(y) + left, row(y) + right, pixel );
+	}
+}
+
+uint32_t Framebuffer::pack( const Colour& colour )
+{
+	double   c[3] = { colour.R(), colour.G(), colour.B() };
+	uint32_t pixel = 0xff000000u;
+
+	for ( int i = 0; i < 3; i += 1 )
+	{
+		double v = std::min( 1.0, std::max( 0.0, c[i] ) );
+		pixel |= (uint32_t)( v * 255.0 + 0.5 ) << ( 8 * i );
+	}
+
+	return pixel;
+}
+
+// Blends "src" over *dst with coverage a, 0 to 255, as
+// d + ( s - d ) * ( a + 1 ) / 256, rounded down, per channel
+static inline void blend( uint32_t* dst, uint32_t src, int a )
+{
+#if defined(__SSE2__)
+	// d * ( 256 - a' ) + s * a' with a' = a + 1 stays within 16 bits
+	__m128i zero = _mm_setzero_si128();
+	__m128i d    = _mm_unpacklo_epi8( _mm_cvtsi32_si128((int)*dst), zero );
+	__m128i s    = _mm_unpacklo_epi8( _mm_cvtsi32_si128((int)src),  zero );
+	__m128i r    = _mm_add_epi16( _mm_mullo_epi16(d, _mm_set1_epi16((short)( 255 - a ))),
+	                              _mm_mullo_epi16(s, _mm_set1_epi16((short)( a + 1 ))) );
+	r = _mm_srli_epi16( r, 8 );
+	*dst = (uint32_t)_mm_cvtsi128_si32( _mm_packus_epi16(r, r) ) | 0xff000000u;
+#else
+	uint32_t d = *dst;
+	uint32_t r = 0xff000000u;
+
+	for ( int shift = 0; shift < 24; shift += 8 )
+	{
+		int dc = ( d   >> shift ) & 0xff;
+		int sc = ( src >> shift ) & 0xff;
+		dc += ( ( sc - dc ) * ( a + 1 ) ) >> 8;
+		r  |= (uint32_t)dc << shift;
+	}
+
+	*dst = r;
+#endif
+}
+
+#if defined(__SSE2__)
+// Blends "src" over *a with coverage ca and over *b with coverage cb, the
+// same as two calls of blend, with both pixels in one register
+static inline void blend_pair( uint32_t* a, int ca, uint32_t* b, int cb,
+                               uint32_t src )
+{
+	// Pixel a in the low four 16-bit lanes, pixel b in the high four
+	__m128i zero = _mm_setzero_si128();
+	__m128i da   = _mm_cvtsi32_si128( (int)*a );
+	__m128i db   = _mm_cvtsi32_si128( (int)*b );
+	__m128i d    = _mm_unpacklo_epi8( _mm_unpacklo_epi32(da, db), zero );
+	__m128i s    = _mm_unpacklo_epi8( _mm_set1_epi32((int)src), zero );
+	__m128i wd   = _mm_set_epi16( (short)( 255 - cb ), (short)( 255 - cb ),
+	                              (short)( 255 - cb ), (short)( 255 - cb ),
+	                              (short)( 255 - ca ), (short)( 255 - ca ),
+	                              (short)( 255 - ca ), (short)( 255 - ca ) );
+	__m128i ws   = _mm_set_epi16( (short)( cb + 1 ), (short)( cb + 1 ),
+	                              (short)( cb + 1 ), (short)( cb + 1 ),
+	                              (short)( ca + 1 ), (short)( ca + 1 ),
+	                              (short)( ca + 1 ), (short)( ca + 1 ) );
+	__m128i r    = _mm_srli_epi16( _mm_add_epi16(_mm_mullo_epi16(d, wd),
+	                                             _mm_mullo_epi16(s, ws)), 8 );
+	r  = _mm_packus_epi16( r, r );
+	*a = (uint32_t)_mm_cvtsi128_si32( r ) | 0xff000000u;
+	*b = (uint32_t)_mm_cvtsi128_si32( _mm_srli_si128(r, 4) ) | 0xff000000u;
+}
+#endif
+
+void Framebuffer::line( const Point2D& p, const Point2D& q,
+                        const Colour& colour )
+{
+	uint32_t src = pack( colour );
+
+	// The pixels the endpoints fall in
+	int x0 = (int)floor( p[0] ), y0 = (int)floor( p[1] );
+	int x1 = (int)floor( q[0] ), y1 = (int)floor( q[1] );
+
+	int dx =  abs( x1 - x0 ), sx = x0 < x1 ? 1 : -1;
+	int dy = -abs( y1 - y0 ), sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for ( ;; )
+	{
+		if ( (unsigned)x0 < (unsigned)m_width &&
+		     (unsigned)y0 < (unsigned)m_height )
+		{
+			m_pixels[y0 * m_width + x0] = src;
+		}
+
+		if ( x0 == x1 && y0 == y1 )
+		{
+			break;
+		}
+
+		int e2 = 2 * err;
+		if ( e2 >= dy )
+		{
+			err += dy;
+			x0  += sx;
+		}
+		if ( e2 <= dx )
+		{
+			err += dx;
+			y0  += sy;
+		}
+	}
+}
+
+void Framebuffer::line_aa( const Point2D& p, const Point2D& q,
+                           const Colour& colour )
+{
+	line_aa( p, q, pack(colour), 0, 0, m_width, m_height );
+}
+
+void Framebuffer::line_aa( const Point2D& p, const Point2D& q,
+                           uint32_t pixel, int left, int top,
+                           int right, int bottom )
+{
+	// Work with pixel centres at integer coordinates
+	double x0 = p[0] - 0.5, y0 = p[1] - 0.5;
+	double x1 = q[0] - 0.5, y1 = q[1] - 0.5;
+
+	// Step along the major axis; "lo" and "hi" bound the pixels that may
+	// be touched along each axis
+	bool steep = fabs( y1 - y0 ) > fabs( x1 - x0 );
+	int  majorLo = left, majorHi = right, minorLo = top, minorHi = bottom;
+	if ( steep )
+	{
+		std::swap( x0, y0 );
+		std::swap( x1, y1 );
+		std::swap( majorLo, minorLo );
+		std::swap( majorHi, minorHi );
+	}
+	if ( x0 > x1 )
+	{
+		std::swap( x0, x1 );
+		std::swap( y0, y1 );
+	}
+
+	double grad = ( x1 > x0 ) ? ( y1 - y0 ) / ( x1 - x0 ) : 0.0;
+
+	// The pixel centres the line passes. The minor coordinate is kept in
+	// 16.16 fixed point, measured from the first of them whatever the
+	// clip rectangle, so that every piece of a line agrees: the integer
+	// part picks the pair of pixels, the top 8 bits of the fraction split
+	// the coverage between them.
+	int     xb    = (int)ceil( x0 );
+	int     xs    = std::max( majorLo,     xb );
+	int     xe    = std::min( majorHi - 1, (int)floor( x1 ) );
+	int32_t ybase = (int32_t)floor( ( y0 + grad * ( xb - x0 ) ) * 65536.0 + 0.5 );
+	int32_t step  = (int32_t)floor( grad * 65536.0 + 0.5 );
+
+	if ( xs > xe )
+	{
+		return;
+	}
+
+	int32_t y = ybase + step * ( xs - xb );
+	int     x = xs;
+
+	// Pixel (major, minor) is at base + major * majorStride + minor *
+	// minorStride
+	uint32_t* base        = &m_pixels[0];
+	int       majorStride = steep ? m_width : 1;
+	int       minorStride = steep ? 1 : m_width;
+
+#if defined(__SSE2__)
+	// Coverage for four columns at a time, and the pair of pixels in each
+	// column blended together
+	alignas(16) int32_t yi[4], f[4];
+	__m128i vy    = _mm_set_epi32( y + 3 * step, y + 2 * step, y + step, y );
+	__m128i vstep = _mm_set1_epi32( 4 * step );
+	__m128i mask  = _mm_set1_epi32( 0xff );
+
+	for ( ; x + 3 <= xe; x += 4, vy = _mm_add_epi32(vy, vstep) )
+	{
+		_mm_store_si128( (__m128i*)yi, _mm_srai_epi32(vy, 16) );
+		_mm_store_si128( (__m128i*)f,
+		                 _mm_and_si128(_mm_srli_epi32(vy, 8), mask) );
+
+		for ( int k = 0; k < 4; k += 1 )
+		{
+			uint32_t* column = base + ( x + k ) * majorStride;
+			int       y0i    = yi[k];
+			bool      first  = y0i >= minorLo && y0i < minorHi && f[k] < 255;
+			bool      second = y0i + 1 >= minorLo && y0i + 1 < minorHi &&
+			                   f[k] > 0;
+			if ( first && second )
+			{
+				blend_pair( column + y0i * minorStride, 255 - f[k],
+				            column + ( y0i + 1 ) * minorStride, f[k], pixel );
+			}
+			else if ( first )
+			{
+				blend( column + y0i * minorStride, pixel, 255 - f[k] );
+			}
+			else if ( second )
+			{
+				blend( column + ( y0i + 1 ) * minorStride, pixel, f[k] );
+			}
+		}
+	}
+	y = ybase + step * ( x - xb );
+#endif
+
+	for ( ; x <= xe; x += 1, y += step )
+	{
+		uint32_t* column = base + x * majorStride;
+		int       y0i    = y >> 16;
+		int       fi     = ( y >> 8 ) & 0xff;
+		if ( y0i >= minorLo && y0i < minorHi && fi < 255 )
+		{
+			blend( column + y0i * minorStride, pixel, 255 - fi );
+		}
+		if ( y0i + 1 >= minorLo && y0i + 1 < minorHi && fi > 0 )
+		{
+			blend( column + ( y0i + 1 ) * minorStride, pixel, fi );
+		}
+	}
+}
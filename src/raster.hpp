@@ -0,0 +1,69 @@
+#ifndef CS488_RASTER_HPP
+#define CS488_RASTER_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "algebra.hpp"
+
+
+// A software framebuffer and line rasterizer, the GL-free counterpart of
+// the GL lines in draw.cpp. Pixels are 8-bit RGBA, stored row by row from
+// the top of the window, which is how window coordinates run. Each pixel
+// is one uint32_t with red in the low byte, so on little-endian machines
+// the memory is laid out R, G, B, A as glDrawPixels and image files want.
+class Framebuffer {
+public:
+	Framebuffer();
+
+	// Resizes to width x height, leaving the contents undefined
+	void            resize    ( int width, int height );
+
+	// Fills every pixel with "colour", fully opaque
+	void            clear     ( const Colour& colour );
+
+	// Fills the pixels in [left, right) x [top, bottom) with "pixel"
+	void            clear     ( uint32_t pixel, int left, int top,
+	                            int right, int bottom );
+
+	// Draws a one pixel wide line between p and q in window coordinates
+	// with integer Bresenham stepping: the pixel whose centre is nearest
+	// the line in each column (or row, for steep lines) is set.
+	void            line      ( const Point2D& p, const Point2D& q,
+	                            const Colour& colour );
+
+	// Same as line, anti-aliased with Xiaolin Wu's algorithm: the line's
+	// coverage in each column (or row) is split between the two pixels
+	// its centre falls between, and blended over what is there, as GL does
+	// with GL_LINE_SMOOTH and alpha blending.
+	void            line_aa   ( const Point2D& p, const Point2D& q,
+	                            const Colour& colour );
+
+	// Same as line_aa, only touching the pixels in [left, right) x
+	// [top, bottom). The pixels touched get exactly the values drawing the
+	// whole line would give them, so a line can be drawn piecewise, tile
+	// by tile.
+	void            line_aa   ( const Point2D& p, const Point2D& q,
+	                            uint32_t pixel, int left, int top,
+	                            int right, int bottom );
+
+	int             width     () const { return m_width; }
+	int             height    () const { return m_height; }
+
+	// Row "y", from the top
+	uint32_t*       row       ( int y )       { return &m_pixels[y * m_width]; }
+	const uint32_t* row       ( int y ) const { return &m_pixels[y * m_width]; }
+	const uint32_t* pixels    () const
+	{
+		return m_pixels.empty() ? NULL : &m_pixels[0];
+	}
+
+	// Packs a colour into a pixel
+	static uint32_t pack      ( const Colour& colour );
+
+private:
+	int                   m_width;
+	int                   m_height;
+	std::vector<uint32_t> m_pixels;
+};
+
+#endif
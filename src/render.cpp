@@ -0,0 +1,276 @@
+// Offline frame export: renders the viewer's scene along a camera path
+// without a display and writes the frames out as images.
+//
+// The frames are what the viewer would show in a window of the given size
+// with the camera placed by the path: the cubes, the gnomons and the
+// viewport outline, drawn by the software rasterizer (draw_soft.cpp) on a
+// pool of worker threads. Without -path the camera turns once around the
+// scene over the frames. -mesh draws an OBJ or PLY wireframe in place of
+// each cube, and -scene a scene cache instead, as ./a2 does.
+//
+// -o names the files with a printf pattern taking the frame number, such
+// as out/%05d.png; the extension picks PNG or PPM. "-o -" writes the bare
+// RGB pixels of every frame to stdout instead, which video tools read as
+// rawvideo rgb24. Without -o the frames are rendered and dropped, to time
+// the renderer alone.
+//
+// The throughput, in frames per second, goes to stderr.
+//
+// Usage: ./render [-cubes n] [-mesh file | -scene file] [-frames n]
+//                 [-size WxH] [-path file] [-o pattern]
+
+#include "campath.hpp"
+#include "draw.hpp"
+#include "image.hpp"
+#include "meshload.hpp"
+#include "pipeline.hpp"
+#include "scenefile.hpp"
+#include "stats.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+
+// Frames in the default orbit
+static const int s_orbitFrames = 120;
+
+// Whether "pattern" holds exactly one conversion, an integer one with an
+// optional flag and width such as %d or %05d, so it is safe to hand to
+// snprintf with the frame number
+static bool valid_pattern( const char* pattern )
+{
+	int conversions = 0;
+
+	for ( const char* c = pattern; *c; c += 1 )
+	{
+		if ( *c != '%' )
+		{
+			continue;
+		}
+		if ( c[1] == '%' )
+		{
+			c += 1;
+			continue;
+		}
+
+		c += 1;
+		while ( *c >= '0' && *c <= '9' )
+		{
+			c += 1;
+		}
+		if ( *c != 'd' )
+		{
+			return false;
+		}
+		conversions += 1;
+	}
+
+	return conversions == 1;
+}
+
+// Draws a frame's lines the way Viewer::on_expose_event does
+static void draw_frame( const LineList& lines, int width, int height )
+{
+	draw_init( width, height );
+
+	size_t colour = (size_t)-1;
+	for ( size_t i = 0; i < lines.size(); i += 1 )
+	{
+		const LineList::Line& line = lines[i];
+		if ( line.colour != colour )
+		{
+			colour = line.colour;
+			set_colour( lines.colour(colour) );
+		}
+		draw_line( line.p, line.q );
+	}
+
+	draw_complete();
+}
+
+static void usage( const char* name )
+{
+	fprintf( stderr, "Usage: %s [-cubes n] [-mesh file | -scene file] "
+	         "[-frames n] [-size WxH] [-path file] [-o pattern]\n", name );
+	exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+	int         cubes     = 1;
+	int         frames    = 0;
+	int         width     = 300;
+	int         height    = 300;
+	const char* meshFile  = NULL;
+	const char* sceneFile = NULL;
+	const char* pathFile  = NULL;
+	const char* output    = NULL;
+
+	for ( int i = 1; i < argc; i += 1 )
+	{
+		if ( !strcmp(argv[i], "-cubes") && i + 1 < argc )
+		{
+			cubes = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-mesh") && i + 1 < argc )
+		{
+			meshFile = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-scene") && i + 1 < argc )
+		{
+			sceneFile = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-frames") && i + 1 < argc )
+		{
+			frames = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-size") && i + 1 < argc )
+		{
+			if ( sscanf(argv[++i], "%dx%d", &width, &height) != 2 ||
+			     width <= 0 || height <= 0 )
+			{
+				usage( argv[0] );
+			}
+		}
+		else if ( !strcmp(argv[i], "-path") && i + 1 < argc )
+		{
+			pathFile = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-o") && i + 1 < argc )
+		{
+			output = argv[++i];
+		}
+		else
+		{
+			usage( argv[0] );
+		}
+	}
+
+	bool stream = output && !strcmp( output, "-" );
+	if ( output && !stream && !valid_pattern(output) )
+	{
+		fprintf( stderr, "%s: -o needs one %%d for the frame number\n",
+		         argv[0] );
+		return 1;
+	}
+
+	// The scene and window, set up as the viewer does. The scene file is
+	// declared first, as the pipeline points into it, and setting the mesh
+	// or the file resets the viewport, so they go first.
+	SceneFile scene;
+	Pipeline  pipeline;
+	pipeline.set_cubes( cubes );
+	if ( meshFile )
+	{
+		Mesh          mesh;
+		MeshLoadStats stats;
+		std::string   error;
+		if ( !load_mesh(meshFile, mesh, Colour(1.0, 1.0, 1.0),
+		                pipeline.scheduler(), error, &stats) )
+		{
+			fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+			return 1;
+		}
+		stats.report( stderr, meshFile );
+
+		fit_mesh( mesh );
+		pipeline.set_mesh( mesh );
+	}
+
+	if ( sceneFile )
+	{
+		std::string error;
+		if ( !scene.open(sceneFile, error) )
+		{
+			fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+			return 1;
+		}
+		pipeline.set_scene_file( &scene );
+	}
+
+	pipeline.set_viewport( width * 0.05, height * 0.05,
+	                       width * 0.95, height * 0.95 );
+	draw_set_scheduler( &pipeline.scheduler() );
+
+	CameraPath path;
+	if ( pathFile )
+	{
+		std::string error;
+		if ( !path.load(pathFile, error) )
+		{
+			fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+			return 1;
+		}
+	}
+	else
+	{
+		path = CameraPath::orbit( pipeline.camera_position(),
+		                          frames > 0 ? frames : s_orbitFrames );
+	}
+
+	// By default, a frame per frame number of the path, the last included;
+	// the orbit ends where it starts, so leave its last frame out
+	if ( frames <= 0 )
+	{
+		frames = pathFile ? (int)path.length() + 1 : s_orbitFrames;
+	}
+
+	double renderNs = 0.0, writeNs = 0.0;
+	char   name[4096];
+
+	for ( int f = 0; f < frames; f += 1 )
+	{
+		double start = stats_now_ns();
+
+		Vector3D   position;
+		Quaternion orientation;
+		path.sample( f, position, orientation );
+		pipeline.set_camera( position, orientation );
+
+		draw_frame( pipeline.frame(), width, height );
+
+		double rendered = stats_now_ns();
+		renderNs += rendered - start;
+
+		bool ok = true;
+		if ( stream )
+		{
+			ok = write_raw( draw_framebuffer(), stdout );
+		}
+		else if ( output )
+		{
+			snprintf( name, sizeof(name), output, f );
+			ok = write_image( draw_framebuffer(), name );
+		}
+
+		if ( !ok )
+		{
+			fprintf( stderr, "%s: %s: %s\n", argv[0],
+			         stream ? "stdout" : name, strerror(errno) );
+			return 1;
+		}
+
+		writeNs += stats_now_ns() - rendered;
+	}
+
+	if ( stream && fflush(stdout) != 0 )
+	{
+		fprintf( stderr, "%s: stdout: %s\n", argv[0], strerror(errno) );
+		return 1;
+	}
+
+	double seconds = ( renderNs + writeNs ) * 1e-9;
+	fprintf( stderr, "%d frames of %dx%d, %d cube(s), in %.3f s: "
+	         "%.1f frames/sec (render %.2f ms, write %.2f ms per frame)\n",
+	         frames, width, height,
+	         (int)pipeline.scene().instance_count(), seconds,
+	         seconds > 0.0 ? frames / seconds : 0.0,
+	         renderNs * 1e-6 / std::max( 1, frames ),
+	         writeNs  * 1e-6 / std::max( 1, frames ) );
+
+	return 0;
+}
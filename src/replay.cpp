@@ -0,0 +1,181 @@
+// Headless replay of a recorded interaction session (see session.hpp).
+//
+// Feeds the calls logged by ./a2 -record back into a Pipeline as fast as
+// it can, and renders a frame wherever the viewer drew one. Each frame's
+// line count and a hash of its lines go to stdout, one line per frame, so
+// that the output of two builds can be compared with diff; the hash
+// covers the exact bits of every coordinate. -quiet prints only the hash
+// of all the frames together.
+//
+// A session recorded with ./a2 -mesh or -scene replays only with the same
+// -mesh or -scene.
+//
+// The time taken, in events and frames per second, goes to stderr.
+//
+// Usage: ./replay [-quiet] [-mesh file | -scene file] session
+
+#include "meshload.hpp"
+#include "pipeline.hpp"
+#include "scenefile.hpp"
+#include "session.hpp"
+#include "stats.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+
+// 64-bit FNV-1a over "size" bytes, continuing from "hash"
+static uint64_t fnv1a( uint64_t hash, const void* data, size_t size )
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for ( size_t i = 0; i < size; i += 1 )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static const uint64_t s_fnvBasis = 14695981039346656037ULL;
+
+// Hash of the lines of a frame: their end points and colours
+static uint64_t hash_lines( const LineList& lines )
+{
+	uint64_t hash = s_fnvBasis;
+
+	for ( size_t i = 0; i < lines.size(); i += 1 )
+	{
+		const LineList::Line& line = lines[i];
+		double coords[4] = { line.p[0], line.p[1], line.q[0], line.q[1] };
+		Colour colour    = lines.colour( line.colour );
+		double rgb[3]    = { colour.R(), colour.G(), colour.B() };
+
+		hash = fnv1a( hash, coords, sizeof(coords) );
+		hash = fnv1a( hash, rgb,    sizeof(rgb) );
+	}
+
+	return hash;
+}
+
+static void usage( const char* name )
+{
+	fprintf( stderr, "Usage: %s [-quiet] [-mesh file | -scene file] "
+	         "session\n", name );
+	exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+	bool        quiet     = false;
+	const char* meshFile  = NULL;
+	const char* sceneFile = NULL;
+	const char* filename  = NULL;
+
+	for ( int i = 1; i < argc; i += 1 )
+	{
+		if ( !strcmp(argv[i], "-quiet") )
+		{
+			quiet = true;
+		}
+		else if ( !strcmp(argv[i], "-mesh") && i + 1 < argc )
+		{
+			meshFile = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-scene") && i + 1 < argc )
+		{
+			sceneFile = argv[++i];
+		}
+		else if ( !filename && argv[i][0] != '-' )
+		{
+			filename = argv[i];
+		}
+		else
+		{
+			usage( argv[0] );
+		}
+	}
+	if ( !filename )
+	{
+		usage( argv[0] );
+	}
+
+	SessionReader reader;
+	std::string   error;
+	if ( !reader.open(filename, error) )
+	{
+		fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+		return 1;
+	}
+
+	// The scene file goes first, as the pipeline points into it
+	SceneFile scene;
+	Pipeline  pipeline;
+	if ( meshFile )
+	{
+		Mesh mesh;
+		if ( !load_mesh(meshFile, mesh, Colour(1.0, 1.0, 1.0),
+		                pipeline.scheduler(), error) )
+		{
+			fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+			return 1;
+		}
+		fit_mesh( mesh );
+		pipeline.set_mesh( mesh );
+	}
+	if ( sceneFile )
+	{
+		if ( !scene.open(sceneFile, error) )
+		{
+			fprintf( stderr, "%s: %s\n", argv[0], error.c_str() );
+			return 1;
+		}
+		pipeline.set_scene_file( &scene );
+	}
+
+	SessionEvent  event;
+	unsigned long events = 0, frames = 0;
+	uint64_t      total  = s_fnvBasis;
+	double        start  = stats_now_ns();
+
+	while ( reader.next(event) )
+	{
+		events += 1;
+
+		if ( event.type != SessionEvent::FRAME )
+		{
+			SessionReader::apply( event, pipeline );
+			continue;
+		}
+
+		const LineList& lines = pipeline.frame();
+		uint64_t        hash  = hash_lines( lines );
+
+		total   = fnv1a( total, &hash, sizeof(hash) );
+		frames += 1;
+
+		if ( !quiet )
+		{
+			printf( "%8lu %8lu %016llx\n", frames, (unsigned long)lines.size(),
+			        (unsigned long long)hash );
+		}
+	}
+
+	double seconds = ( stats_now_ns() - start ) * 1e-9;
+
+	if ( !reader.error().empty() )
+	{
+		fprintf( stderr, "%s: %s\n", argv[0], reader.error().c_str() );
+		return 1;
+	}
+
+	printf( "total %016llx\n", (unsigned long long)total );
+	fprintf( stderr, "%lu events, %lu frames in %.3f s: %.0f events/sec, "
+	         "%.1f frames/sec\n", events, frames, seconds,
+	         seconds > 0.0 ? events / seconds : 0.0,
+	         seconds > 0.0 ? frames / seconds : 0.0 );
+
+	return 0;
+}
@@ -0,0 +1,336 @@
+#include "scene.hpp"
+#include "a2.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+
+int Mesh::add_vertex( const Point3D& p )
+{
+	xs.push_back( (float)p[0] );
+	ys.push_back( (float)p[1] );
+	zs.push_back( (float)p[2] );
+
+	return (int)xs.size() - 1;
+}
+
+void Mesh::add_edge( int a, int b, const Colour& colour )
+{
+	size_t c = 0;
+	while ( c < palette.size() &&
+	        ( palette[c].R() != colour.R() || palette[c].G() != colour.G() ||
+	          palette[c].B() != colour.B() ) )
+	{
+		c += 1;
+	}
+	if ( c == palette.size() )
+	{
+		palette.push_back( colour );
+	}
+
+	edges.push_back( a );
+	edges.push_back( b );
+	colours.push_back( (uint16_t)c );
+}
+
+MeshView Mesh::view() const
+{
+	MeshView view = {
+		xs.empty()      ? NULL : &xs[0],
+		ys.empty()      ? NULL : &ys[0],
+		zs.empty()      ? NULL : &zs[0],
+		edges.empty()   ? NULL : &edges[0],
+		colours.empty() ? NULL : &colours[0],
+		palette.empty() ? NULL : &palette[0],
+		vertex_count(),
+		edge_count(),
+		palette.size()
+	};
+
+	return view;
+}
+
+// A sphere around the vertices of "mesh": centred on their bounding box,
+// and just reaching the furthest of them
+static Sphere bound_mesh( const MeshView& mesh )
+{
+	Sphere sphere = { Point3D(), 0.0 };
+	size_t n      = mesh.vertex_count;
+
+	if ( n == 0 )
+	{
+		return sphere;
+	}
+
+	const float* axes[3] = { mesh.xs, mesh.ys, mesh.zs };
+	for ( int a = 0; a < 3; a += 1 )
+	{
+		const float* v = axes[a];
+		float lo = v[0], hi = v[0];
+		for ( size_t i = 1; i < n; i += 1 )
+		{
+			lo = std::min( lo, v[i] );
+			hi = std::max( hi, v[i] );
+		}
+		sphere.centre[a] = 0.5 * ( (double)lo + hi );
+	}
+
+	double r2 = 0.0;
+	for ( size_t i = 0; i < n; i += 1 )
+	{
+		double dx = mesh.xs[i] - sphere.centre[0];
+		double dy = mesh.ys[i] - sphere.centre[1];
+		double dz = mesh.zs[i] - sphere.centre[2];
+		r2 = std::max( r2, dx * dx + dy * dy + dz * dz );
+	}
+	sphere.radius = sqrt( r2 );
+
+	return sphere;
+}
+
+Scene::Scene()
+	: m_edgeCount       ( 0 )
+	, m_treeBuilt       ( false )
+	, m_modellingVersion( 0 )
+	, m_scalingVersion  ( 0 )
+{
+}
+
+void Scene::clear()
+{
+	m_modellingVersion += 1;
+	m_scalingVersion   += 1;
+
+	m_meshes.clear();
+	m_views.clear();
+	m_meshBounds.clear();
+	m_mesh.clear();
+	m_position.clear();
+	m_orientation.clear();
+	m_modelling.clear();
+	m_scale.clear();
+	m_transform.clear();
+	m_bounds.clear();
+	m_edgeCount = 0;
+
+	m_tree.clear();
+	m_treeBuilt = false;
+}
+
+int Scene::add_mesh( const Mesh& mesh )
+{
+	m_meshes.push_back( mesh );
+
+	return add_mesh( m_meshes.back().view() );
+}
+
+int Scene::add_mesh( const MeshView& mesh )
+{
+	m_views.push_back( mesh );
+	m_meshBounds.push_back( bound_mesh(mesh) );
+	m_modellingVersion += 1;
+
+	return (int)m_views.size() - 1;
+}
+
+int Scene::add_instance( int mesh, const Vector3D& position,
+                         const Quaternion& orientation, const Vector3D& scale )
+{
+	m_mesh.push_back( mesh );
+	m_position.push_back( position );
+	m_orientation.push_back( orientation );
+	m_modelling.push_back( Matrix4x4d() );
+	m_scale.push_back( scale );
+	m_transform.push_back( Matrix4x4f() );
+	m_bounds.push_back( Sphere() );
+	m_edgeCount += m_views[mesh].edge_count;
+	m_treeBuilt  = false;
+	update( m_mesh.size() - 1 );
+	m_modellingVersion += 1;
+	m_scalingVersion   += 1;
+
+	return (int)m_mesh.size() - 1;
+}
+
+void Scene::add_grid( int mesh, int count, double extent, double fill )
+{
+	int    side = (int)ceil( cbrt((double)count) );
+	double cell = 2.0 * extent / side;
+	double size = fill * cell;
+
+	m_mesh.reserve( m_mesh.size() + count );
+	m_position.reserve( m_position.size() + count );
+	m_orientation.reserve( m_orientation.size() + count );
+	m_modelling.reserve( m_modelling.size() + count );
+	m_scale.reserve( m_scale.size() + count );
+	m_transform.reserve( m_transform.size() + count );
+	m_bounds.reserve( m_bounds.size() + count );
+
+	for ( int i = 0; i < count; i += 1 )
+	{
+		int x = i % side;
+		int y = ( i / side ) % side;
+		int z = i / ( side * side );
+
+		add_instance( mesh, Vector3D(-extent + ( x + 0.5 ) * cell,
+		                             -extent + ( y + 0.5 ) * cell,
+		                             -extent + ( z + 0.5 ) * cell),
+		              Quaternion(), Vector3D(size, size, size) );
+	}
+}
+
+void Scene::set_pose( size_t i, const Vector3D& position,
+                      const Quaternion& orientation )
+{
+	m_position[i]    = position;
+	m_orientation[i] = orientation;
+	update( i );
+	m_modellingVersion += 1;
+}
+
+void Scene::set_scale( size_t i, const Vector3D& scale )
+{
+	m_scale[i] = scale;
+	update( i );
+	m_scalingVersion += 1;
+}
+
+void Scene::update( size_t i )
+{
+	// The pose: the rotation, with the displacement in the last column
+	Matrix4x4       pose = m_orientation[i].matrix();
+	const Vector3D& p    = m_position[i];
+	pose[0][3] = p[0];
+	pose[1][3] = p[1];
+	pose[2][3] = p[2];
+	m_modelling[i] = Matrix4x4d( pose );
+
+	// Scaling first is the same as scaling the first three columns of the
+	// modelling transform
+	const Matrix4x4d& m = m_modelling[i];
+	Matrix4x4f&       t = m_transform[i];
+
+	for ( size_t j = 0; j < 4; j += 1 )
+	{
+		double s = j < 3 ? m_scale[i][j] : 1.0;
+		for ( size_t k = 0; k < 4; k += 1 )
+		{
+			t.column(j)[k] = (float)( m(k, j) * s );
+		}
+	}
+
+	// The pose is a rotation, so the sphere around the mesh moves with its
+	// centre and grows with the largest scale factor
+	const Sphere& mesh   = m_meshBounds[m_mesh[i]];
+	Sphere&       bounds = m_bounds[i];
+	Point3D       centre( mesh.centre[0] * m_scale[i][0],
+	                      mesh.centre[1] * m_scale[i][1],
+	                      mesh.centre[2] * m_scale[i][2] );
+	double        scale = std::max( fabs(m_scale[i][0]),
+	                                std::max(fabs(m_scale[i][1]),
+	                                         fabs(m_scale[i][2])) );
+
+	bounds.centre = pose * centre;
+	bounds.radius = mesh.radius * scale;
+
+	// Leave room for the vertices being transformed in single precision
+	bounds.radius += 1e-5 * ( bounds.radius + fabs(bounds.centre[0]) +
+	                          fabs(bounds.centre[1]) + fabs(bounds.centre[2]) );
+
+	if ( m_treeBuilt )
+	{
+		m_tree.moved( i );
+	}
+}
+
+const InstanceTree& Scene::tree() const
+{
+	if ( !m_treeBuilt )
+	{
+		m_tree.build( m_bounds.empty() ? NULL : &m_bounds[0], m_bounds.size() );
+		m_treeBuilt = true;
+	}
+	else if ( m_tree.stale() )
+	{
+		m_tree.refit( &m_bounds[0] );
+	}
+
+	return m_tree;
+}
+
+Mesh unit_cube_mesh()
+{
+	Mesh   cube;
+	Colour white( 1, 1, 1 );
+	Colour grey ( 0.1, 0.1, 0.1 );
+
+	cube.add_vertex( Point3D( 1.0, -1.0, -1.0) );
+	cube.add_vertex( Point3D(-1.0, -1.0, -1.0) );
+	cube.add_vertex( Point3D(-1.0,  1.0, -1.0) );
+	cube.add_vertex( Point3D( 1.0,  1.0, -1.0) );
+	cube.add_vertex( Point3D(-1.0, -1.0,  1.0) );
+	cube.add_vertex( Point3D( 1.0, -1.0,  1.0) );
+	cube.add_vertex( Point3D( 1.0,  1.0,  1.0) );
+	cube.add_vertex( Point3D(-1.0,  1.0,  1.0) );
+
+	cube.add_edge( 0, 1, white );
+	cube.add_edge( 0, 3, white );
+	cube.add_edge( 0, 5, grey  );
+	cube.add_edge( 1, 2, white );
+	cube.add_edge( 1, 4, grey  );
+	cube.add_edge( 2, 3, white );
+	cube.add_edge( 2, 7, grey  );
+	cube.add_edge( 3, 6, grey  );
+	cube.add_edge( 4, 5, grey  );
+	cube.add_edge( 4, 7, grey  );
+	cube.add_edge( 5, 6, grey  );
+	cube.add_edge( 6, 7, grey  );
+
+	return cube;
+}
+
+void fit_mesh( Mesh& mesh )
+{
+	if ( mesh.xs.empty() )
+	{
+		return;
+	}
+
+	float lo[3], hi[3];
+	std::vector<float>* axes[3] = { &mesh.xs, &mesh.ys, &mesh.zs };
+	for ( int a = 0; a < 3; a += 1 )
+	{
+		lo[a] = *std::min_element( axes[a]->begin(), axes[a]->end() );
+		hi[a] = *std::max_element( axes[a]->begin(), axes[a]->end() );
+	}
+
+	float size  = std::max( hi[0] - lo[0],
+	                        std::max(hi[1] - lo[1], hi[2] - lo[2]) );
+	float scale = size > 0.0f ? 2.0f / size : 1.0f;
+
+	for ( int a = 0; a < 3; a += 1 )
+	{
+		std::vector<float>& v = *axes[a];
+		float centre = 0.5f * ( lo[a] + hi[a] );
+		for ( size_t i = 0; i < v.size(); i += 1 )
+		{
+			v[i] = ( v[i] - centre ) * scale;
+		}
+	}
+}
+
+Mesh gnomon_mesh( const Colour& colour )
+{
+	Mesh gnomon;
+
+	gnomon.add_vertex( Point3D(0.0, 0.0, 0.0) );
+	gnomon.add_vertex( Point3D(0.5, 0.0, 0.0) );
+	gnomon.add_vertex( Point3D(0.0, 0.5, 0.0) );
+	gnomon.add_vertex( Point3D(0.0, 0.0, 0.5) );
+
+	gnomon.add_edge( 0, 1, colour );
+	gnomon.add_edge( 0, 2, colour );
+	gnomon.add_edge( 0, 3, colour );
+
+	return gnomon;
+}
@@ -0,0 +1,189 @@
+#ifndef CS488_SCENE_HPP
+#define CS488_SCENE_HPP
+
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include "algebra.hpp"
+#include "bvh.hpp"
+#include "quaternion.hpp"
+#include "simd.hpp"
+
+
+// The arrays of a mesh, wherever they live: in a Mesh, or in a mapped
+// scene file (see scenefile.hpp). This is all the renderer reads.
+struct MeshView {
+	const float*    xs;
+	const float*    ys;
+	const float*    zs;
+	// Pairs of vertex indices, one pair per edge
+	const int*      edges;
+	// Index into the palette of each edge's colour
+	const uint16_t* colours;
+	const Colour*   palette;
+
+	size_t          vertex_count;
+	size_t          edge_count;
+	size_t          palette_size;
+};
+
+// A sphere bounding a mesh or an instance of one
+struct Sphere {
+	Point3D centre;
+	double  radius;
+};
+
+// A wireframe mesh: vertex positions in model coordinates and the edges
+// between them, each edge with its own colour. Positions are kept as
+// separate x, y and z arrays so they can be fed straight to
+// transform_points. Edges name their colour by its index in the mesh's
+// palette, so a mesh with millions of edges in one colour doesn't carry
+// millions of copies of it.
+struct Mesh {
+	std::vector<float>    xs;
+	std::vector<float>    ys;
+	std::vector<float>    zs;
+	// Pairs of vertex indices, one pair per edge
+	std::vector<int>      edges;
+	// One palette index per edge
+	std::vector<uint16_t> colours;
+	// The distinct colours of the edges
+	std::vector<Colour>   palette;
+
+	// Appends a vertex and returns its index
+	int  add_vertex( const Point3D& p );
+
+	// Appends an edge between vertices a and b, adding the colour to the
+	// palette if it isn't in it yet
+	void add_edge  ( int a, int b, const Colour& colour );
+
+	// Number of vertices and edges in the mesh
+	size_t vertex_count() const { return xs.size(); }
+	size_t edge_count  () const { return edges.size() / 2; }
+
+	// The arrays of the mesh, valid until it is next changed
+	MeshView view() const;
+};
+
+// Everything drawn in a frame: a set of meshes, shared between any number
+// of instances of them. Meshes are either copied in, or only referred to,
+// for those that live elsewhere such as in a mapped scene file. Instance
+// data lives in flat arrays indexed by instance rather than in one object
+// per instance, so that scenes with hundreds of thousands of instances
+// stay cache friendly.
+//
+// Each instance has a pose, an orientation followed by a displacement, and
+// a separate per-axis scale applied before it. The modelling transform of
+// the pose, and its product with the scale in single precision for the
+// renderer, are kept up to date from them.
+class Scene {
+public:
+	Scene();
+
+	// Removes all meshes and instances
+	void              clear         ();
+
+	// Adds a copy of a mesh and returns its index
+	int               add_mesh      ( const Mesh& mesh );
+
+	// Adds a mesh without copying it and returns its index. Its arrays
+	// have to outlive the scene, or its next clear().
+	int               add_mesh      ( const MeshView& mesh );
+
+	// Adds an instance of mesh "mesh" and returns its index
+	int               add_instance  ( int mesh, const Vector3D& position,
+	                                  const Quaternion& orientation =
+	                                      Quaternion(),
+	                                  const Vector3D& scale =
+	                                      Vector3D(1.0, 1.0, 1.0) );
+
+	// Adds "count" instances of mesh "mesh" on a regular grid filling the
+	// volume [-extent, extent]^3, each scaled by "fill" times the size of
+	// its grid cell
+	void              add_grid      ( int mesh, int count, double extent,
+	                                  double fill );
+
+	size_t            mesh_count    () const { return m_views.size(); }
+	size_t            instance_count() const { return m_mesh.size(); }
+	// Edges in all the instances together
+	size_t            edge_count    () const { return m_edgeCount; }
+
+	const MeshView&   mesh          ( int m ) const { return m_views[m]; }
+	// Bounding sphere of mesh m, in model coordinates
+	const Sphere&     mesh_bounds   ( int m ) const { return m_meshBounds[m]; }
+
+	// Per-instance data
+	int               mesh_of       ( size_t i ) const { return m_mesh[i]; }
+	const Vector3D&   position      ( size_t i ) const { return m_position[i]; }
+	const Quaternion& orientation   ( size_t i ) const
+	{
+		return m_orientation[i];
+	}
+	// The pose as a matrix
+	const Matrix4x4d& modelling     ( size_t i ) const { return m_modelling[i]; }
+	const Vector3D&   scale         ( size_t i ) const { return m_scale[i]; }
+	// Modelling transform times scale
+	const Matrix4x4f& transform     ( size_t i ) const { return m_transform[i]; }
+	// Bounding sphere of the instance in world coordinates, for culling
+	const Sphere&     bounds        ( size_t i ) const { return m_bounds[i]; }
+
+	// The hierarchy over the instance bounds, built the first time it is
+	// asked for after instances come or go, and refitted around the ones
+	// that moved since. That makes this not safe to call from several
+	// threads at once; the renderer calls it before handing out work.
+	const InstanceTree& tree        () const;
+
+	void              set_pose      ( size_t i, const Vector3D& position,
+	                                  const Quaternion& orientation );
+	void              set_scale     ( size_t i, const Vector3D& scale );
+
+	// Counters bumped on every change to the poses and the scales
+	// respectively, including meshes and instances coming or going
+	unsigned long     modelling_version() const { return m_modellingVersion; }
+	unsigned long     scaling_version  () const { return m_scalingVersion; }
+
+private:
+	// The views of copied meshes point into m_meshes, so a copy of the
+	// scene would point into this one's
+	Scene( const Scene& );
+	Scene& operator=( const Scene& );
+
+	// Recomputes the transform and bounds of instance i
+	void              update        ( size_t i );
+
+	// The meshes that were copied in, and every mesh's arrays; a
+	// list, so that adding a mesh leaves the arrays of the rest in place
+	std::list<Mesh>         m_meshes;
+	std::vector<MeshView>   m_views;
+	std::vector<Sphere>     m_meshBounds;
+
+	std::vector<int>        m_mesh;
+	std::vector<Vector3D>   m_position;
+	std::vector<Quaternion> m_orientation;
+	std::vector<Matrix4x4d> m_modelling;
+	std::vector<Vector3D>   m_scale;
+	std::vector<Matrix4x4f> m_transform;
+	std::vector<Sphere>     m_bounds;
+	size_t                  m_edgeCount;
+
+	// Brought up to date by tree(). Until it is first built, there is
+	// nothing to mark when instances move.
+	mutable InstanceTree    m_tree;
+	mutable bool            m_treeBuilt;
+
+	unsigned long           m_modellingVersion;
+	unsigned long           m_scalingVersion;
+};
+
+// The unit cube drawn by the viewer: front face in white, the rest in a
+// dark grey
+Mesh unit_cube_mesh();
+
+// Moves and scales "mesh" uniformly to fill the unit cube's box,
+// [-1, 1]^3, along its longest side, centred on the origin
+void fit_mesh( Mesh& mesh );
+
+// A gnomon of length 0.5 along each axis, drawn in the given colour
+Mesh gnomon_mesh( const Colour& colour );
+
+#endif
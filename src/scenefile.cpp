@@ -0,0 +1,437 @@
+#include "scenefile.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// File header: magic and format version
+static const char s_magic[4] = { 'A', '2', 'S', 'C' };
+
+// Sections start on multiples of this
+static const size_t s_align = 64;
+
+// Size of an element of each section
+static const size_t s_elementSize[SceneFile::SECTIONS] = {
+	sizeof(float), sizeof(float), sizeof(float),
+	2 * sizeof(int32_t),
+	sizeof(uint16_t),
+	3 * sizeof(double),
+	sizeof(SceneFileMesh),
+	sizeof(SceneFileInstance)
+};
+
+static const char* s_sectionName[SceneFile::SECTIONS] = {
+	"xs", "ys", "zs", "edges", "colours", "palette", "meshes", "instances"
+};
+
+struct SceneFile::Header {
+	char     magic[4];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t reserved;
+	uint64_t file_size;
+
+	struct {
+		uint64_t offset;
+		uint64_t size;
+		uint64_t checksum;
+	}        sections[SECTIONS];
+
+	// Of everything above
+	uint64_t checksum;
+};
+
+static inline uint64_t rotl( uint64_t x, int r )
+{
+	return x << r | x >> ( 64 - r );
+}
+
+// 64-bit checksum of "size" bytes. Four independent lanes of
+// multiply-rotate over 8-byte words keep it running at about the speed
+// memory can be read, so checking a file costs little more than reading
+// it.
+static uint64_t checksum( const void* data, size_t size )
+{
+	const uint64_t P1 = 0x9e3779b185ebca87ULL;
+	const uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+
+	const unsigned char* p    = (const unsigned char*)data;
+	uint64_t             h[4] = { P1, P2, ~P1, ~P2 };
+	size_t               i    = 0;
+
+	for ( ; i + 32 <= size; i += 32 )
+	{
+		for ( int l = 0; l < 4; l += 1 )
+		{
+			uint64_t word;
+			memcpy( &word, p + i + 8 * l, 8 );
+			h[l] = rotl( h[l] ^ word * P2, 31 ) * P1;
+		}
+	}
+
+	// The last few bytes, zero padded
+	unsigned char tail[32] = { 0 };
+	memcpy( tail, p + i, size - i );
+	for ( int l = 0; l < 4; l += 1 )
+	{
+		uint64_t word;
+		memcpy( &word, tail + 8 * l, 8 );
+		h[l] = rotl( h[l] ^ word * P2, 31 ) * P1;
+	}
+
+	uint64_t result = size;
+	for ( int l = 0; l < 4; l += 1 )
+	{
+		result = rotl( result ^ h[l], 27 ) * P1 + P2;
+	}
+	result ^= result >> 29;
+
+	return result;
+}
+
+static bool little_endian()
+{
+	uint16_t one = 1;
+	unsigned char first;
+	memcpy( &first, &one, 1 );
+
+	return first == 1;
+}
+
+SceneFile::SceneFile()
+	: m_header       ( NULL )
+	, m_instances    ( NULL )
+	, m_instanceCount( 0 )
+{
+}
+
+void SceneFile::close()
+{
+	m_file.close();
+	m_header        = NULL;
+	m_instances     = NULL;
+	m_instanceCount = 0;
+	m_views.clear();
+	m_palette.clear();
+}
+
+bool SceneFile::open( const char* filename, std::string& error )
+{
+	close();
+	m_filename = filename;
+
+	if ( !little_endian() )
+	{
+		error = m_filename + ": scene files need a little-endian machine";
+		return false;
+	}
+	if ( !m_file.open(filename, error) )
+	{
+		return false;
+	}
+
+	const char* data = m_file.data();
+	size_t      size = m_file.size();
+	Header      header;
+
+	if ( size < sizeof(Header) || memcmp(data, s_magic, 4) != 0 )
+	{
+		error = m_filename + ": not a scene file";
+		close();
+		return false;
+	}
+	memcpy( &header, data, sizeof(Header) );
+	if ( header.version != SCENE_FILE_VERSION )
+	{
+		error = m_filename + ": unsupported scene file version";
+		close();
+		return false;
+	}
+	if ( header.header_size != sizeof(Header) || header.file_size != size ||
+	     header.checksum != checksum(&header, offsetof(Header, checksum)) )
+	{
+		error = m_filename + ": damaged header";
+		close();
+		return false;
+	}
+
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		uint64_t offset = header.sections[s].offset;
+		uint64_t bytes  = header.sections[s].size;
+		if ( offset % s_align != 0 || offset < sizeof(Header) ||
+		     offset > size || bytes > size - offset ||
+		     bytes % s_elementSize[s] != 0 )
+		{
+			error = m_filename + ": damaged " + s_sectionName[s] + " section";
+			close();
+			return false;
+		}
+	}
+
+	m_header = (const Header*)data;
+
+	// Counts of the elements of each section, and the sections themselves
+	size_t      counts[SECTIONS];
+	const char* starts[SECTIONS];
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		counts[s] = header.sections[s].size / s_elementSize[s];
+		starts[s] = data + header.sections[s].offset;
+	}
+
+	const double* palette = (const double*)starts[PALETTE];
+	for ( size_t c = 0; c < counts[PALETTE]; c += 1 )
+	{
+		m_palette.push_back( Colour(palette[3 * c], palette[3 * c + 1],
+		                            palette[3 * c + 2]) );
+	}
+
+	const SceneFileMesh* meshes = (const SceneFileMesh*)starts[MESHES];
+	for ( size_t m = 0; m < counts[MESHES]; m += 1 )
+	{
+		const SceneFileMesh& mesh = meshes[m];
+		if ( mesh.first_vertex > counts[XS] ||
+		     mesh.vertices     > counts[XS] - mesh.first_vertex ||
+		     counts[YS] != counts[XS] || counts[ZS] != counts[XS] ||
+		     mesh.first_edge   > counts[EDGES] ||
+		     mesh.edges        > counts[EDGES] - mesh.first_edge ||
+		     counts[COLOURS]   != counts[EDGES] ||
+		     mesh.first_colour > counts[PALETTE] ||
+		     mesh.colours      > counts[PALETTE] - mesh.first_colour ||
+		     ( mesh.edges > 0 && mesh.colours == 0 ) )
+		{
+			error = m_filename + ": damaged mesh table";
+			close();
+			return false;
+		}
+
+		MeshView view = {
+			(const float*)starts[XS] + mesh.first_vertex,
+			(const float*)starts[YS] + mesh.first_vertex,
+			(const float*)starts[ZS] + mesh.first_vertex,
+			(const int*)starts[EDGES] + 2 * mesh.first_edge,
+			(const uint16_t*)starts[COLOURS] + mesh.first_edge,
+			m_palette.empty() ? NULL : &m_palette[0] + mesh.first_colour,
+			(size_t)mesh.vertices,
+			(size_t)mesh.edges,
+			(size_t)mesh.colours
+		};
+
+		// Indices out of range would have the renderer read outside the
+		// mapping. This reads only the edge and colour arrays, so the
+		// vertices stay untouched until they are drawn
+		for ( size_t e = 0; e < view.edge_count; e += 1 )
+		{
+			if ( (size_t)view.edges[2 * e]     >= view.vertex_count ||
+			     (size_t)view.edges[2 * e + 1] >= view.vertex_count ||
+			     view.colours[e]               >= view.palette_size )
+			{
+				error = m_filename + ": index out of range in mesh " +
+				        std::to_string( m );
+				close();
+				return false;
+			}
+		}
+
+		m_views.push_back( view );
+	}
+
+	m_instances     = (const SceneFileInstance*)starts[INSTANCES];
+	m_instanceCount = counts[INSTANCES];
+	for ( size_t i = 0; i < m_instanceCount; i += 1 )
+	{
+		if ( m_instances[i].mesh >= m_views.size() )
+		{
+			error = m_filename + ": instance of a missing mesh";
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool SceneFile::verify( std::string& error ) const
+{
+	const char* data = m_file.data();
+
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		if ( checksum(data + m_header->sections[s].offset,
+		              m_header->sections[s].size) !=
+		     m_header->sections[s].checksum )
+		{
+			error = m_filename + ": bad checksum of the " + s_sectionName[s] +
+			        " section";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SceneFile::populate( Scene& scene ) const
+{
+	int first = (int)scene.mesh_count();
+	for ( size_t m = 0; m < m_views.size(); m += 1 )
+	{
+		scene.add_mesh( m_views[m] );
+	}
+
+	for ( size_t i = 0; i < m_instanceCount; i += 1 )
+	{
+		const SceneFileInstance& instance = m_instances[i];
+		const double*            q        = instance.orientation;
+
+		scene.add_instance( first + (int)instance.mesh,
+		                    Vector3D(instance.position[0],
+		                             instance.position[1],
+		                             instance.position[2]),
+		                    Quaternion(q[0], q[1], q[2], q[3]),
+		                    Vector3D(instance.scale[0], instance.scale[1],
+		                             instance.scale[2]) );
+	}
+}
+
+// Rounds up to the next section boundary
+static size_t align( size_t offset )
+{
+	return ( offset + s_align - 1 ) / s_align * s_align;
+}
+
+bool SceneFile::write( const char* filename, const Scene& scene,
+                       std::string& error )
+{
+	if ( !little_endian() )
+	{
+		error = std::string( filename ) +
+		        ": scene files need a little-endian machine";
+		return false;
+	}
+
+	// Lay the sections out
+	size_t counts[SECTIONS] = { 0 };
+	counts[MESHES]    = scene.mesh_count();
+	counts[INSTANCES] = scene.instance_count();
+	for ( size_t m = 0; m < scene.mesh_count(); m += 1 )
+	{
+		const MeshView& mesh = scene.mesh( (int)m );
+		counts[XS]      += mesh.vertex_count;
+		counts[EDGES]   += mesh.edge_count;
+		counts[PALETTE] += mesh.palette_size;
+	}
+	counts[YS] = counts[ZS] = counts[XS];
+	counts[COLOURS] = counts[EDGES];
+
+	Header header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, s_magic, 4 );
+	header.version     = SCENE_FILE_VERSION;
+	header.header_size = sizeof(Header);
+
+	size_t offset = align( sizeof(Header) );
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		header.sections[s].offset = offset;
+		header.sections[s].size   = counts[s] * s_elementSize[s];
+		offset = align( offset + header.sections[s].size );
+	}
+	header.file_size = offset;
+
+	// Build the file in memory, then write it in one go
+	std::vector<char> image( offset, 0 );
+	char* at[SECTIONS];
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		at[s] = &image[0] + header.sections[s].offset;
+	}
+
+	SceneFileMesh entry = { 0, 0, 0, 0, 0, 0 };
+	for ( size_t m = 0; m < scene.mesh_count(); m += 1 )
+	{
+		const MeshView& mesh = scene.mesh( (int)m );
+		entry.vertices = mesh.vertex_count;
+		entry.edges    = mesh.edge_count;
+		entry.colours  = mesh.palette_size;
+
+		size_t bytes = mesh.vertex_count * sizeof(float);
+		if ( bytes > 0 )
+		{
+			memcpy( at[XS], mesh.xs, bytes );
+			memcpy( at[YS], mesh.ys, bytes );
+			memcpy( at[ZS], mesh.zs, bytes );
+		}
+		bytes = mesh.edge_count * s_elementSize[EDGES];
+		if ( bytes > 0 )
+		{
+			memcpy( at[EDGES], mesh.edges, bytes );
+			memcpy( at[COLOURS], mesh.colours,
+			        mesh.edge_count * sizeof(uint16_t) );
+		}
+		for ( size_t c = 0; c < mesh.palette_size; c += 1 )
+		{
+			double rgb[3] = { mesh.palette[c].R(), mesh.palette[c].G(),
+			                  mesh.palette[c].B() };
+			memcpy( at[PALETTE] + c * sizeof(rgb), rgb, sizeof(rgb) );
+		}
+		memcpy( at[MESHES], &entry, sizeof(entry) );
+
+		at[XS]      += mesh.vertex_count * sizeof(float);
+		at[YS]      += mesh.vertex_count * sizeof(float);
+		at[ZS]      += mesh.vertex_count * sizeof(float);
+		at[EDGES]   += mesh.edge_count * s_elementSize[EDGES];
+		at[COLOURS] += mesh.edge_count * sizeof(uint16_t);
+		at[PALETTE] += mesh.palette_size * s_elementSize[PALETTE];
+		at[MESHES]  += sizeof(entry);
+
+		entry.first_vertex += mesh.vertex_count;
+		entry.first_edge   += mesh.edge_count;
+		entry.first_colour += mesh.palette_size;
+	}
+
+	for ( size_t i = 0; i < scene.instance_count(); i += 1 )
+	{
+		SceneFileInstance instance;
+		memset( &instance, 0, sizeof(instance) );
+		instance.mesh = (uint32_t)scene.mesh_of( i );
+		for ( int k = 0; k < 3; k += 1 )
+		{
+			instance.position[k] = scene.position( i )[k];
+			instance.scale[k]    = scene.scale( i )[k];
+		}
+		for ( int k = 0; k < 4; k += 1 )
+		{
+			instance.orientation[k] = scene.orientation( i )[k];
+		}
+		memcpy( at[INSTANCES] + i * sizeof(instance), &instance,
+		        sizeof(instance) );
+	}
+
+	for ( int s = 0; s < SECTIONS; s += 1 )
+	{
+		header.sections[s].checksum =
+		    checksum( &image[0] + header.sections[s].offset,
+		              header.sections[s].size );
+	}
+	header.checksum = checksum( &header, offsetof(Header, checksum) );
+	memcpy( &image[0], &header, sizeof(header) );
+
+	FILE* file = fopen( filename, "wb" );
+	if ( !file )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		return false;
+	}
+
+	bool ok = fwrite( &image[0], 1, image.size(), file ) == image.size();
+	ok      = fclose( file ) == 0 && ok;
+	if ( !ok )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		return false;
+	}
+
+	return true;
+}
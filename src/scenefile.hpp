@@ -0,0 +1,123 @@
+#ifndef CS488_SCENEFILE_HPP
+#define CS488_SCENEFILE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mapfile.hpp"
+#include "scene.hpp"
+
+
+// Scene cache files: the meshes and instances of a Scene in a binary
+// form that is memory-mapped and drawn from in place, so that opening
+// one costs a pass over its edge indices rather than a parse.
+//
+// The file is a header followed by sections, each starting on a 64-byte
+// boundary so the arrays in it are aligned for the SIMD kernels:
+//
+//   XS, YS, ZS  float vertex coordinates of all the meshes, one after
+//               the other (the layout of Mesh)
+//   EDGES       int32 vertex index pairs, indices counting from the first
+//               vertex of the edge's mesh
+//   COLOURS     uint16 palette index of every edge, counting from the
+//               first palette entry of its mesh
+//   PALETTE     double r, g, b of every colour
+//   MESHES      SceneFileMesh, one per mesh
+//   INSTANCES   SceneFileInstance, one per instance
+//
+// Everything is little-endian. The header records where each section is,
+// how big it is and a checksum of it, and ends with a checksum of itself.
+// Opening a file checks the header, the mesh and instance tables and
+// that every edge and colour index is in range, which reads those two
+// sections but not the vertices. Checking the section checksums means
+// reading all of them, so that is left to SceneFile::verify().
+
+// Format version; bumped on any change to the layout
+enum { SCENE_FILE_VERSION = 1 };
+
+// Where each mesh's arrays are in the sections, as counts of elements
+struct SceneFileMesh {
+	uint64_t first_vertex;
+	uint64_t vertices;
+	uint64_t first_edge;
+	uint64_t edges;
+	uint64_t first_colour;
+	uint64_t colours;
+};
+
+// An instance: the index of its mesh and its pose and scale, which the
+// modelling matrices are made from as Scene::add_instance does
+struct SceneFileInstance {
+	uint32_t mesh;
+	uint32_t reserved;
+	double   position[3];
+	double   orientation[4];
+	double   scale[3];
+};
+
+class SceneFile {
+public:
+	enum Section {
+		XS,
+		YS,
+		ZS,
+		EDGES,
+		COLOURS,
+		PALETTE,
+		MESHES,
+		INSTANCES,
+		SECTIONS
+	};
+
+	SceneFile();
+
+	// Maps "filename" and checks its header, tables and indices. Returns
+	// false, with the reason in "error", if it can't be mapped, isn't a
+	// scene file of this version or would have the renderer read outside
+	// the mapping.
+	bool        open          ( const char* filename, std::string& error );
+	void        close         ();
+	bool        is_open       () const { return m_header != NULL; }
+
+	// Checks every section against its checksum, which reads the whole
+	// file. Returns false, with the reason in "error", on a mismatch.
+	bool        verify        ( std::string& error ) const;
+
+	size_t      mesh_count    () const { return m_views.size(); }
+	size_t      instance_count() const { return m_instanceCount; }
+
+	// The arrays of mesh m, pointing into the mapping
+	const MeshView&          mesh    ( size_t m ) const { return m_views[m]; }
+	const SceneFileInstance& instance( size_t i ) const
+	{
+		return m_instances[i];
+	}
+
+	// Size of the file
+	size_t      bytes         () const { return m_file.size(); }
+
+	// Adds all the meshes, without copying them, and all the instances to
+	// "scene", which must be cleared or destroyed before the file is closed
+	void        populate      ( Scene& scene ) const;
+
+	// Writes the meshes and instances of "scene" to "filename". Returns
+	// false, with the reason in "error", if the file can't be written.
+	static bool write         ( const char* filename, const Scene& scene,
+	                            std::string& error );
+
+private:
+	struct Header;
+
+	MappedFile               m_file;
+	const Header*            m_header;
+	std::string              m_filename;
+
+	std::vector<MeshView>    m_views;
+	// The palette is copied out, into the Colour objects edges point at
+	std::vector<Colour>      m_palette;
+	const SceneFileInstance* m_instances;
+	size_t                   m_instanceCount;
+};
+
+#endif
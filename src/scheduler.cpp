@@ -0,0 +1,128 @@
+#include "scheduler.hpp"
+
+#include <chrono>
+
+
+Scheduler::Scheduler( size_t workers )
+	: m_pool  ( workers )
+	, m_queues( m_pool.size() )
+{
+	reset_stats();
+}
+
+void Scheduler::run( size_t tasks,
+                     const std::function<void(size_t, size_t)>& task )
+{
+	size_t n = m_queues.size();
+
+	// Deal the tasks out in contiguous blocks
+	for ( size_t w = 0; w < n; w += 1 )
+	{
+		m_queues[w].begin = tasks * w / n;
+		m_queues[w].end   = tasks * ( w + 1 ) / n;
+	}
+
+	m_pool.run( [&]( size_t w ) { work( w, task ); } );
+}
+
+WorkerStats Scheduler::total() const
+{
+	WorkerStats sum = { 0, 0, 0, 0.0 };
+
+	for ( size_t w = 0; w < m_queues.size(); w += 1 )
+	{
+		const WorkerStats& stats = m_queues[w].stats;
+		sum.tasks   += stats.tasks;
+		sum.steals  += stats.steals;
+		sum.misses  += stats.misses;
+		sum.idle_ns += stats.idle_ns;
+	}
+
+	return sum;
+}
+
+void Scheduler::reset_stats()
+{
+	for ( size_t w = 0; w < m_queues.size(); w += 1 )
+	{
+		WorkerStats zero = { 0, 0, 0, 0.0 };
+		m_queues[w].stats = zero;
+	}
+}
+
+void Scheduler::work( size_t w, const std::function<void(size_t, size_t)>& task )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	WorkerStats& stats = m_queues[w].stats;
+	size_t       t;
+
+	for ( ;; )
+	{
+		while ( pop(w, t) )
+		{
+			task( t, w );
+			stats.tasks += 1;
+		}
+
+		// Out of work: look for some elsewhere, and count the time until
+		// either some turns up or there's none left anywhere
+		Clock::time_point idle = Clock::now();
+		bool found = steal( w );
+		stats.idle_ns += std::chrono::duration<double, std::nano>(
+		                     Clock::now() - idle ).count();
+		if ( !found )
+		{
+			return;
+		}
+	}
+}
+
+bool Scheduler::pop( size_t w, size_t& t )
+{
+	Queue& queue = m_queues[w];
+	std::lock_guard<std::mutex> lock( queue.lock );
+
+	if ( queue.begin == queue.end )
+	{
+		return false;
+	}
+	t = queue.begin++;
+	return true;
+}
+
+bool Scheduler::steal( size_t w )
+{
+	size_t n = m_queues.size();
+	Queue& own = m_queues[w];
+
+	// No tasks are added during a run, so once a pass over the others
+	// comes up empty there is nothing left to steal
+	for ( size_t i = 1; i < n; i += 1 )
+	{
+		Queue& victim = m_queues[( w + i ) % n];
+		size_t begin, end;
+
+		{
+			std::lock_guard<std::mutex> lock( victim.lock );
+			size_t left = victim.end - victim.begin;
+			if ( left == 0 )
+			{
+				continue;
+			}
+			// Leave the victim the front half, which it is about to run
+			begin      = victim.end - ( left + 1 ) / 2;
+			end        = victim.end;
+			victim.end = begin;
+		}
+
+		std::lock_guard<std::mutex> lock( own.lock );
+		own.begin = begin;
+		own.end   = end;
+		own.stats.steals += 1;
+		return true;
+	}
+
+	own.stats.misses += 1;
+	return false;
+}
@@ -0,0 +1,71 @@
+#ifndef CS488_SCHEDULER_HPP
+#define CS488_SCHEDULER_HPP
+
+#include <stddef.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "workers.hpp"
+
+
+// What each worker of a Scheduler did, summed over the runs since the
+// last reset
+struct WorkerStats {
+	// Tasks run
+	unsigned long tasks;
+	// Successful and failed attempts to take work from another worker
+	unsigned long steals;
+	unsigned long misses;
+	// Time spent with nothing of its own left to run, in nanoseconds
+	double        idle_ns;
+};
+
+// Work-stealing scheduler over a WorkerPool. A run is a range of tasks
+// that starts out dealt to the workers in contiguous blocks; each worker
+// runs its block front to back, and one that runs dry steals the back
+// half of another's, so cheap and expensive tasks even out without any
+// up-front estimate of their cost.
+class Scheduler {
+public:
+	// Same as WorkerPool( workers )
+	explicit Scheduler( size_t workers = 0 );
+
+	size_t             workers    () const { return m_pool.size(); }
+
+	// Calls task( t, w ) for every t in [0, tasks), where w is the worker
+	// running it, and returns once all of them have returned
+	void               run        ( size_t tasks,
+	                                const std::function<void(size_t, size_t)>& task );
+
+	const WorkerStats& stats      ( size_t worker ) const
+	{
+		return m_queues[worker].stats;
+	}
+	// Sum of the statistics of all the workers
+	WorkerStats        total      () const;
+	void               reset_stats();
+
+private:
+	// The tasks one worker has left. The owner takes from the front and
+	// thieves from the back, both under the lock.
+	struct alignas(64) Queue {
+		std::mutex  lock;
+		size_t      begin;
+		size_t      end;
+		WorkerStats stats;
+	};
+
+	// Body of worker w during a run
+	void   work ( size_t w, const std::function<void(size_t, size_t)>& task );
+
+	// Takes the next task of worker w's own queue into t
+	bool   pop  ( size_t w, size_t& t );
+
+	// Moves the back half of some other worker's queue to worker w's
+	bool   steal( size_t w );
+
+	WorkerPool         m_pool;
+	std::vector<Queue> m_queues;
+};
+
+#endif
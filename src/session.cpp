@@ -0,0 +1,410 @@
+#include "session.hpp"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+
+// File header: magic and format version
+static const char    s_magic[4] = { 'A', '2', 'R', 'S' };
+static const uint8_t s_version  = 1;
+
+// Event tags. Motion by a whole number of pixels that fits 16 bits is
+// logged as SHORT_MOTION, anything else as MOTION.
+enum Tag {
+	TAG_RESET        = 'R',
+	TAG_CUBES        = 'C',
+	TAG_PERSPECTIVE  = 'P',
+	TAG_VIEWPORT     = 'V',
+	TAG_CAMERA       = 'K',
+	TAG_SELECT       = 'S',
+	TAG_MODE         = 'O',
+	TAG_MOTION       = 'M',
+	TAG_SHORT_MOTION = 'm',
+	TAG_FRAME        = 'F'
+};
+
+SessionRecorder::SessionRecorder()
+	: m_file  ( NULL )
+	, m_failed( false )
+	, m_mode  ( -1 )
+	, m_events( 0 )
+	, m_bytes ( 0 )
+{
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	close();
+}
+
+bool SessionRecorder::open( const char* filename, std::string& error )
+{
+	close();
+
+	m_file = fopen( filename, "wb" );
+	if ( !m_file )
+	{
+		error = std::string( filename ) + ": " + strerror( errno );
+		return false;
+	}
+
+	m_failed = false;
+	m_mode   = -1;
+	m_events = 0;
+	m_bytes  = 0;
+
+	for ( int i = 0; i < 4; i += 1 )
+	{
+		put_byte( s_magic[i] );
+	}
+	put_byte( s_version );
+
+	return true;
+}
+
+bool SessionRecorder::close()
+{
+	if ( !m_file )
+	{
+		return true;
+	}
+
+	bool ok = fclose( m_file ) == 0 && !m_failed;
+	m_file  = NULL;
+
+	return ok;
+}
+
+void SessionRecorder::put_byte( uint8_t value )
+{
+	if ( m_file )
+	{
+		m_failed = m_failed || putc( value, m_file ) == EOF;
+		m_bytes += 1;
+	}
+}
+
+void SessionRecorder::put_u32( uint32_t value )
+{
+	for ( int shift = 0; shift < 32; shift += 8 )
+	{
+		put_byte( (uint8_t)( value >> shift ) );
+	}
+}
+
+void SessionRecorder::put_double( double value )
+{
+	uint64_t bits;
+	memcpy( &bits, &value, sizeof(bits) );
+
+	put_u32( (uint32_t)bits );
+	put_u32( (uint32_t)( bits >> 32 ) );
+}
+
+void SessionRecorder::reset()
+{
+	put_byte( TAG_RESET );
+	m_events += 1;
+}
+
+void SessionRecorder::cubes( int count )
+{
+	put_byte( TAG_CUBES );
+	put_u32( (uint32_t)count );
+	m_events += 1;
+}
+
+void SessionRecorder::perspective( double fov, double aspect,
+                                   double near, double far )
+{
+	put_byte( TAG_PERSPECTIVE );
+	put_double( fov );
+	put_double( aspect );
+	put_double( near );
+	put_double( far );
+	m_events += 1;
+}
+
+void SessionRecorder::viewport( double x1, double y1, double x2, double y2 )
+{
+	put_byte( TAG_VIEWPORT );
+	put_double( x1 );
+	put_double( y1 );
+	put_double( x2 );
+	put_double( y2 );
+	m_events += 1;
+}
+
+void SessionRecorder::camera( const Vector3D& position,
+                              const Quaternion& orientation )
+{
+	put_byte( TAG_CAMERA );
+	for ( int i = 0; i < 3; i += 1 )
+	{
+		put_double( position[i] );
+	}
+	for ( int i = 0; i < 4; i += 1 )
+	{
+		put_double( orientation[i] );
+	}
+	m_events += 1;
+}
+
+void SessionRecorder::select( size_t first, size_t count )
+{
+	put_byte( TAG_SELECT );
+	put_u32( (uint32_t)first );
+	put_u32( (uint32_t)count );
+	m_events += 1;
+}
+
+void SessionRecorder::motion( Pipeline::Mode mode, bool button1,
+                              bool button2, bool button3, double delta )
+{
+	if ( mode != m_mode )
+	{
+		put_byte( TAG_MODE );
+		put_byte( (uint8_t)mode );
+		m_mode    = mode;
+		m_events += 1;
+	}
+
+	uint8_t buttons = ( button1 ? 1 : 0 ) | ( button2 ? 2 : 0 ) |
+	                  ( button3 ? 4 : 0 );
+
+	if ( delta == floor(delta) && fabs(delta) < 32768.0 )
+	{
+		int16_t pixels = (int16_t)delta;
+		put_byte( TAG_SHORT_MOTION );
+		put_byte( buttons );
+		put_byte( (uint8_t)pixels );
+		put_byte( (uint8_t)( (uint16_t)pixels >> 8 ) );
+	}
+	else
+	{
+		put_byte( TAG_MOTION );
+		put_byte( buttons );
+		put_double( delta );
+	}
+	m_events += 1;
+}
+
+void SessionRecorder::frame()
+{
+	put_byte( TAG_FRAME );
+	m_events += 1;
+}
+
+SessionReader::SessionReader()
+	: m_file( NULL )
+	, m_mode( Pipeline::VIEWROTATE )
+{
+}
+
+SessionReader::~SessionReader()
+{
+	if ( m_file )
+	{
+		fclose( m_file );
+	}
+}
+
+bool SessionReader::open( const char* filename, std::string& error )
+{
+	if ( m_file )
+	{
+		fclose( m_file );
+	}
+
+	m_filename = filename;
+	m_error.clear();
+	m_mode     = Pipeline::VIEWROTATE;
+
+	m_file = fopen( filename, "rb" );
+	if ( !m_file )
+	{
+		error = m_filename + ": " + strerror( errno );
+		return false;
+	}
+
+	uint8_t header[5];
+	bool    ok = true;
+	for ( int i = 0; i < 5 && ok; i += 1 )
+	{
+		ok = get_byte( header[i] );
+	}
+
+	if ( !ok || memcmp(header, s_magic, 4) != 0 )
+	{
+		error = m_filename + ": not a session";
+		return false;
+	}
+	if ( header[4] != s_version )
+	{
+		error = m_filename + ": unsupported session version";
+		return false;
+	}
+
+	return true;
+}
+
+bool SessionReader::get_byte( uint8_t& value )
+{
+	int c = m_file ? getc( m_file ) : EOF;
+	value = (uint8_t)c;
+
+	return c != EOF;
+}
+
+bool SessionReader::get_u32( uint32_t& value )
+{
+	value = 0;
+	for ( int shift = 0; shift < 32; shift += 8 )
+	{
+		uint8_t byte;
+		if ( !get_byte(byte) )
+		{
+			return false;
+		}
+		value |= (uint32_t)byte << shift;
+	}
+
+	return true;
+}
+
+bool SessionReader::get_double( double& value )
+{
+	uint32_t lo, hi;
+	if ( !get_u32(lo) || !get_u32(hi) )
+	{
+		return false;
+	}
+
+	uint64_t bits = (uint64_t)hi << 32 | lo;
+	memcpy( &value, &bits, sizeof(value) );
+
+	return true;
+}
+
+bool SessionReader::next( SessionEvent& event )
+{
+	uint8_t tag;
+	if ( !get_byte(tag) )
+	{
+		return false;
+	}
+
+	bool     ok = true;
+	uint8_t  byte;
+	uint32_t word;
+
+	memset( &event, 0, sizeof(event) );
+	event.mode = m_mode;
+
+	switch ( tag )
+	{
+	case TAG_RESET:
+		event.type = SessionEvent::RESET;
+		break;
+	case TAG_CUBES:
+		event.type  = SessionEvent::CUBES;
+		ok          = get_u32( word );
+		event.count = word;
+		break;
+	case TAG_PERSPECTIVE:
+	case TAG_VIEWPORT:
+		event.type = ( tag == TAG_PERSPECTIVE ) ? SessionEvent::PERSPECTIVE
+		                                        : SessionEvent::VIEWPORT;
+		for ( int i = 0; i < 4 && ok; i += 1 )
+		{
+			ok = get_double( event.values[i] );
+		}
+		break;
+	case TAG_CAMERA:
+		event.type = SessionEvent::CAMERA;
+		for ( int i = 0; i < 7 && ok; i += 1 )
+		{
+			ok = get_double( event.values[i] );
+		}
+		break;
+	case TAG_SELECT:
+		event.type  = SessionEvent::SELECT;
+		ok          = get_u32( word );
+		event.first = word;
+		ok          = ok && get_u32( word );
+		event.count = word;
+		break;
+	case TAG_MODE:
+		event.type = SessionEvent::MODE;
+		ok         = get_byte( byte ) && byte <= Pipeline::VIEWPORT;
+		event.mode = m_mode = (Pipeline::Mode)byte;
+		break;
+	case TAG_MOTION:
+	case TAG_SHORT_MOTION:
+		event.type = SessionEvent::MOTION;
+		ok         = get_byte( byte );
+		event.button1 = ( byte & 1 ) != 0;
+		event.button2 = ( byte & 2 ) != 0;
+		event.button3 = ( byte & 4 ) != 0;
+		if ( tag == TAG_MOTION )
+		{
+			ok = ok && get_double( event.delta );
+		}
+		else
+		{
+			uint8_t lo = 0, hi = 0;
+			ok = ok && get_byte( lo ) && get_byte( hi );
+			event.delta = (int16_t)( lo | hi << 8 );
+		}
+		break;
+	case TAG_FRAME:
+		event.type = SessionEvent::FRAME;
+		break;
+	default:
+		ok = false;
+		break;
+	}
+
+	if ( !ok )
+	{
+		m_error = m_filename + ": damaged at byte " +
+		          std::to_string( ftell(m_file) );
+	}
+
+	return ok;
+}
+
+void SessionReader::apply( const SessionEvent& event, Pipeline& pipeline )
+{
+	const double* v = event.values;
+
+	switch ( event.type )
+	{
+	case SessionEvent::RESET:
+		pipeline.reset();
+		break;
+	case SessionEvent::CUBES:
+		pipeline.set_cubes( (int)event.count );
+		break;
+	case SessionEvent::PERSPECTIVE:
+		pipeline.set_perspective( v[0], v[1], v[2], v[3] );
+		break;
+	case SessionEvent::VIEWPORT:
+		pipeline.set_viewport( v[0], v[1], v[2], v[3] );
+		break;
+	case SessionEvent::CAMERA:
+		pipeline.set_camera( Vector3D(v[0], v[1], v[2]),
+		                     Quaternion(v[3], v[4], v[5], v[6]) );
+		break;
+	case SessionEvent::SELECT:
+		pipeline.select( event.first, event.count );
+		break;
+	case SessionEvent::MOTION:
+		pipeline.motion( event.mode, event.button1, event.button2,
+		                 event.button3, event.delta );
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,125 @@
+#ifndef CS488_SESSION_HPP
+#define CS488_SESSION_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "pipeline.hpp"
+
+
+// Recording and replaying interaction sessions. A recorder attached to a
+// Pipeline (see Pipeline::set_recorder) logs every call that changes its
+// state, along with a mark each time a frame is drawn; replaying the log
+// makes the same calls on another Pipeline, which then goes through the
+// same states and draws the same frames, bit for bit. Sessions are
+// reproducible workloads taken from real use, and the frames they draw
+// can be compared between builds.
+//
+// The file is a header, "A2RS" and a version byte, followed by events:
+// a tag byte and its arguments, little-endian. Motion carries only the
+// buttons and the delta, in two bytes when it is a whole number of pixels
+// as it usually is; the mode is logged separately, when it changes. There
+// are no timestamps: a replay runs as fast as it can.
+
+// One logged call
+struct SessionEvent {
+	enum Type {
+		RESET,        // Pipeline::reset
+		CUBES,        // set_cubes( count )
+		PERSPECTIVE,  // set_perspective( values[0..3] )
+		VIEWPORT,     // set_viewport( values[0..3] )
+		CAMERA,       // set_camera( values[0..2], values[3..6] )
+		SELECT,       // select( first, count )
+		MODE,         // the mode of the motion that follows
+		MOTION,       // motion( mode, buttons, delta )
+		FRAME         // a frame was drawn
+	};
+
+	Type           type;
+	Pipeline::Mode mode;
+	bool           button1, button2, button3;
+	double         delta;
+	double         values[7];
+	unsigned long  first;
+	unsigned long  count;
+};
+
+class SessionRecorder {
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	// Starts a new session in "filename", closing any open one. Returns
+	// false and describes the problem in "error" if it can't be created.
+	bool open       ( const char* filename, std::string& error );
+
+	// Finishes the session. Returns false if any of it couldn't be written.
+	bool close      ();
+
+	bool is_open    () const { return m_file != NULL; }
+
+	// Events logged so far, and the bytes they took
+	unsigned long events() const { return m_events; }
+	unsigned long bytes () const { return m_bytes; }
+
+	// Logging, called by Pipeline
+	void reset      ();
+	void cubes      ( int count );
+	void perspective( double fov, double aspect, double near, double far );
+	void viewport   ( double x1, double y1, double x2, double y2 );
+	void camera     ( const Vector3D& position, const Quaternion& orientation );
+	void select     ( size_t first, size_t count );
+	void motion     ( Pipeline::Mode mode, bool button1, bool button2,
+	                  bool button3, double delta );
+	void frame      ();
+
+private:
+	SessionRecorder( const SessionRecorder& );
+	SessionRecorder& operator=( const SessionRecorder& );
+
+	void put_byte   ( uint8_t value );
+	void put_u32    ( uint32_t value );
+	void put_double ( double value );
+
+	FILE*          m_file;
+	bool           m_failed;
+	// The mode last logged, or -1 before any
+	int            m_mode;
+	unsigned long  m_events;
+	unsigned long  m_bytes;
+};
+
+class SessionReader {
+public:
+	SessionReader();
+	~SessionReader();
+
+	// Opens the session in "filename". Returns false and describes the
+	// problem in "error" if it can't be read.
+	bool open      ( const char* filename, std::string& error );
+
+	// Reads the next event. Returns false at the end of the session, or if
+	// the rest of it is damaged, when error() says so.
+	bool next      ( SessionEvent& event );
+
+	const std::string& error() const { return m_error; }
+
+	// Makes the call "event" stands for on "pipeline". Frame marks do
+	// nothing; drawing the frame is up to the caller.
+	static void apply( const SessionEvent& event, Pipeline& pipeline );
+
+private:
+	SessionReader( const SessionReader& );
+	SessionReader& operator=( const SessionReader& );
+
+	bool get_byte  ( uint8_t& value );
+	bool get_u32   ( uint32_t& value );
+	bool get_double( double& value );
+
+	FILE*          m_file;
+	std::string    m_filename;
+	std::string    m_error;
+	Pipeline::Mode m_mode;
+};
+
+#endif
@@ -0,0 +1,324 @@
+//---------------------------------------------------------------------------
+//
+// simd.hpp
+//
+// Aligned float and double 4x4 matrices and 4-wide points for the
+// per-frame transform path. Matrices are stored by column, so both the
+// matrix-point and the matrix-matrix products are a handful of
+// broadcast-multiply-adds on whole columns with no temporaries. SSE is
+// used for floats and SSE2 (or AVX, when compiled with -mavx) for
+// doubles; other targets fall back to plain loops.
+//
+// The classes in algebra.hpp remain the reference types; these convert
+// from them and are meant for transforming many points per frame.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_SIMD_HPP
+#define CS488_SIMD_HPP
+
+#include "algebra.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+class alignas(16) Point4f
+{
+public:
+  Point4f()
+  {
+    v_[0] = 0.0f;
+    v_[1] = 0.0f;
+    v_[2] = 0.0f;
+    v_[3] = 1.0f;
+  }
+  Point4f(float x, float y, float z, float w = 1.0f)
+  {
+    v_[0] = x;
+    v_[1] = y;
+    v_[2] = z;
+    v_[3] = w;
+  }
+  explicit Point4f(const Point3D& p)
+  {
+    v_[0] = (float)p[0];
+    v_[1] = (float)p[1];
+    v_[2] = (float)p[2];
+    v_[3] = 1.0f;
+  }
+
+  float& operator[](size_t idx)
+  {
+    return v_[ idx ];
+  }
+  float operator[](size_t idx) const
+  {
+    return v_[ idx ];
+  }
+
+  float *data()
+  {
+    return v_;
+  }
+  const float *data() const
+  {
+    return v_;
+  }
+
+  Point3D point3d() const
+  {
+    return Point3D(v_[0], v_[1], v_[2]);
+  }
+
+private:
+  float v_[4];
+};
+
+class alignas(32) Point4d
+{
+public:
+  Point4d()
+  {
+    v_[0] = 0.0;
+    v_[1] = 0.0;
+    v_[2] = 0.0;
+    v_[3] = 1.0;
+  }
+  Point4d(double x, double y, double z, double w = 1.0)
+  {
+    v_[0] = x;
+    v_[1] = y;
+    v_[2] = z;
+    v_[3] = w;
+  }
+  explicit Point4d(const Point3D& p)
+  {
+    v_[0] = p[0];
+    v_[1] = p[1];
+    v_[2] = p[2];
+    v_[3] = 1.0;
+  }
+
+  double& operator[](size_t idx)
+  {
+    return v_[ idx ];
+  }
+  double operator[](size_t idx) const
+  {
+    return v_[ idx ];
+  }
+
+  double *data()
+  {
+    return v_;
+  }
+  const double *data() const
+  {
+    return v_;
+  }
+
+  Point3D point3d() const
+  {
+    return Point3D(v_[0], v_[1], v_[2]);
+  }
+
+private:
+  double v_[4];
+};
+
+class alignas(16) Matrix4x4f
+{
+public:
+  Matrix4x4f()
+  {
+    // Construct an identity matrix
+    std::fill(v_, v_+16, 0.0f);
+    v_[0] = 1.0f;
+    v_[5] = 1.0f;
+    v_[10] = 1.0f;
+    v_[15] = 1.0f;
+  }
+  explicit Matrix4x4f(const Matrix4x4& m)
+  {
+    for(size_t i = 0; i < 4; ++i) {
+      for(size_t j = 0; j < 4; ++j) {
+        v_[4*j+i] = (float)m[i][j];
+      }
+    }
+  }
+
+  // Column "col" as four consecutive floats
+  float *column(size_t col)
+  {
+    return v_ + 4*col;
+  }
+  const float *column(size_t col) const
+  {
+    return v_ + 4*col;
+  }
+
+  float operator()(size_t row, size_t col) const
+  {
+    return v_[4*col+row];
+  }
+
+private:
+  float v_[16];
+};
+
+class alignas(32) Matrix4x4d
+{
+public:
+  Matrix4x4d()
+  {
+    // Construct an identity matrix
+    std::fill(v_, v_+16, 0.0);
+    v_[0] = 1.0;
+    v_[5] = 1.0;
+    v_[10] = 1.0;
+    v_[15] = 1.0;
+  }
+  explicit Matrix4x4d(const Matrix4x4& m)
+  {
+    for(size_t i = 0; i < 4; ++i) {
+      for(size_t j = 0; j < 4; ++j) {
+        v_[4*j+i] = m[i][j];
+      }
+    }
+  }
+
+  // Column "col" as four consecutive doubles
+  double *column(size_t col)
+  {
+    return v_ + 4*col;
+  }
+  const double *column(size_t col) const
+  {
+    return v_ + 4*col;
+  }
+
+  double operator()(size_t row, size_t col) const
+  {
+    return v_[4*col+row];
+  }
+
+  Matrix4x4 matrix() const
+  {
+    Matrix4x4 m;
+    for(size_t i = 0; i < 4; ++i) {
+      for(size_t j = 0; j < 4; ++j) {
+        m[i][j] = v_[4*j+i];
+      }
+    }
+    return m;
+  }
+
+private:
+  double v_[16];
+};
+
+// Rounds a double precision matrix to single precision
+inline Matrix4x4f to_float(const Matrix4x4d& m)
+{
+  Matrix4x4f ret;
+  for(size_t j = 0; j < 4; ++j) {
+    for(size_t i = 0; i < 4; ++i) {
+      ret.column(j)[i] = (float)m(i, j);
+    }
+  }
+  return ret;
+}
+
+// out = m * (x, y, z, w), with out 16-byte aligned
+inline void transform4(const Matrix4x4f& m, float x, float y, float z,
+                       float w, float *out)
+{
+#if defined(__SSE2__)
+  __m128 r = _mm_mul_ps(_mm_load_ps(m.column(0)), _mm_set1_ps(x));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m.column(1)), _mm_set1_ps(y)));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m.column(2)), _mm_set1_ps(z)));
+  r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(m.column(3)), _mm_set1_ps(w)));
+  _mm_store_ps(out, r);
+#else
+  for(size_t i = 0; i < 4; ++i) {
+    out[i] = m(i, 0) * x + m(i, 1) * y + m(i, 2) * z + m(i, 3) * w;
+  }
+#endif
+}
+
+// out = m * (x, y, z, w), with out 32-byte aligned
+inline void transform4(const Matrix4x4d& m, double x, double y, double z,
+                       double w, double *out)
+{
+#if defined(__AVX__)
+  __m256d r = _mm256_mul_pd(_mm256_load_pd(m.column(0)), _mm256_set1_pd(x));
+  r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_load_pd(m.column(1)),
+                                     _mm256_set1_pd(y)));
+  r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_load_pd(m.column(2)),
+                                     _mm256_set1_pd(z)));
+  r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_load_pd(m.column(3)),
+                                     _mm256_set1_pd(w)));
+  _mm256_store_pd(out, r);
+#elif defined(__SSE2__)
+  __m128d bx = _mm_set1_pd(x);
+  __m128d by = _mm_set1_pd(y);
+  __m128d bz = _mm_set1_pd(z);
+  __m128d bw = _mm_set1_pd(w);
+  for(size_t h = 0; h < 4; h += 2) {
+    __m128d r = _mm_mul_pd(_mm_load_pd(m.column(0) + h), bx);
+    r = _mm_add_pd(r, _mm_mul_pd(_mm_load_pd(m.column(1) + h), by));
+    r = _mm_add_pd(r, _mm_mul_pd(_mm_load_pd(m.column(2) + h), bz));
+    r = _mm_add_pd(r, _mm_mul_pd(_mm_load_pd(m.column(3) + h), bw));
+    _mm_store_pd(out + h, r);
+  }
+#else
+  for(size_t i = 0; i < 4; ++i) {
+    out[i] = m(i, 0) * x + m(i, 1) * y + m(i, 2) * z + m(i, 3) * w;
+  }
+#endif
+}
+
+inline Point4f operator *(const Matrix4x4f& m, const Point4f& p)
+{
+  Point4f ret;
+  transform4(m, p[0], p[1], p[2], p[3], ret.data());
+  return ret;
+}
+
+inline Point4d operator *(const Matrix4x4d& m, const Point4d& p)
+{
+  Point4d ret;
+  transform4(m, p[0], p[1], p[2], p[3], ret.data());
+  return ret;
+}
+
+// Each column of a*b is a times the matching column of b
+inline Matrix4x4f operator *(const Matrix4x4f& a, const Matrix4x4f& b)
+{
+  Matrix4x4f ret;
+
+  for(size_t j = 0; j < 4; ++j) {
+    const float *c = b.column(j);
+    transform4(a, c[0], c[1], c[2], c[3], ret.column(j));
+  }
+
+  return ret;
+}
+
+inline Matrix4x4d operator *(const Matrix4x4d& a, const Matrix4x4d& b)
+{
+  Matrix4x4d ret;
+
+  for(size_t j = 0; j < 4; ++j) {
+    const double *c = b.column(j);
+    transform4(a, c[0], c[1], c[2], c[3], ret.column(j));
+  }
+
+  return ret;
+}
+
+#endif // CS488_SIMD_HPP
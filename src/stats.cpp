@@ -0,0 +1,192 @@
+#include "stats.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+
+const double RollingHistogram::MIN = 1e-3;
+
+void add_stats( RenderStats& a, const RenderStats& b )
+{
+	a.transform_ns += b.transform_ns;
+	a.clip_ns      += b.clip_ns;
+	a.merge_ns     += b.merge_ns;
+	a.edges        += b.edges;
+	a.drawn        += b.drawn;
+	a.instances    += b.instances;
+	a.rejected     += b.rejected;
+	a.accepted     += b.accepted;
+}
+
+RollingHistogram::RollingHistogram()
+{
+	clear();
+}
+
+void RollingHistogram::clear()
+{
+	std::fill( m_buckets, m_buckets + BUCKETS, 0 );
+	m_next     = 0;
+	m_count    = 0;
+	m_sum      = 0.0;
+	m_maxFirst = 0;
+	m_maxCount = 0;
+}
+
+double RollingHistogram::lower( size_t b )
+{
+	return b == 0 ? 0.0 : MIN * pow( 2.0, ( b - 1 ) / 8.0 );
+}
+
+size_t RollingHistogram::bucket_of( double value )
+{
+	if ( !( value >= MIN ) )
+	{
+		return 0;
+	}
+
+	double b = floor( log2(value / MIN) * 8.0 ) + 1;
+	return (size_t)std::min( b, (double)BUCKETS - 1 );
+}
+
+void RollingHistogram::add( double value )
+{
+	// The oldest value makes way once the window is full
+	if ( m_count == WINDOW )
+	{
+		if ( m_maxCount > 0 && m_maxAt[m_maxFirst] == m_next )
+		{
+			m_maxFirst  = ( m_maxFirst + 1 ) % WINDOW;
+			m_maxCount -= 1;
+		}
+		m_buckets[bucket_of( m_values[m_next] )] -= 1;
+		m_sum   -= m_values[m_next];
+		m_count -= 1;
+	}
+
+	// Values no bigger than the new one can't be the max while it's in
+	// the window
+	while ( m_maxCount > 0 &&
+	        m_values[m_maxAt[( m_maxFirst + m_maxCount - 1 ) % WINDOW]] <= value )
+	{
+		m_maxCount -= 1;
+	}
+	m_maxAt[( m_maxFirst + m_maxCount ) % WINDOW] = m_next;
+	m_maxCount += 1;
+
+	m_values[m_next]               = value;
+	m_buckets[bucket_of( value )] += 1;
+	m_sum                         += value;
+	m_count                       += 1;
+	m_next                         = ( m_next + 1 ) % WINDOW;
+}
+
+double RollingHistogram::last() const
+{
+	return m_count == 0 ? 0.0 : m_values[( m_next + WINDOW - 1 ) % WINDOW];
+}
+
+double RollingHistogram::mean() const
+{
+	return m_count == 0 ? 0.0 : m_sum / m_count;
+}
+
+double RollingHistogram::max() const
+{
+	return m_maxCount == 0 ? 0.0 : m_values[m_maxAt[m_maxFirst]];
+}
+
+double RollingHistogram::percentile( double pct ) const
+{
+	if ( m_count == 0 )
+	{
+		return 0.0;
+	}
+
+	// The bucket holding the value of that rank
+	size_t rank = (size_t)ceil( pct / 100.0 * m_count );
+	size_t seen = 0;
+	size_t b    = 0;
+	for ( ; b + 1 < BUCKETS; b += 1 )
+	{
+		seen += m_buckets[b];
+		if ( seen >= std::max( rank, (size_t)1 ) )
+		{
+			break;
+		}
+	}
+
+	// The last bucket has no upper edge; nothing in it is above the max
+	return b + 1 < BUCKETS ? std::min( lower(b + 1), max() ) : max();
+}
+
+FrameStats::FrameStats()
+{
+	clear();
+}
+
+void FrameStats::clear()
+{
+	for ( int s = 0; s < STAGES; s += 1 )
+	{
+		m_stages[s].clear();
+	}
+	m_frames    = 0;
+	m_edges     = 0;
+	m_drawn     = 0;
+	m_instances = 0;
+	m_rejected  = 0;
+	m_accepted  = 0;
+}
+
+const char* FrameStats::name( Stage stage )
+{
+	static const char* names[STAGES] = {
+		"transform", "clip", "merge", "submit", "swap", "frame"
+	};
+
+	return names[stage];
+}
+
+void FrameStats::add( const RenderStats& render, double submit_ns,
+                      double swap_ns, double frame_ns )
+{
+	m_stages[TRANSFORM].add( render.transform_ns * 1e-6 );
+	m_stages[CLIP]     .add( render.clip_ns      * 1e-6 );
+	m_stages[MERGE]    .add( render.merge_ns     * 1e-6 );
+	m_stages[SUBMIT]   .add( submit_ns           * 1e-6 );
+	m_stages[SWAP]     .add( swap_ns             * 1e-6 );
+	m_stages[FRAME]    .add( frame_ns            * 1e-6 );
+
+	m_frames   += 1;
+	m_edges     = render.edges;
+	m_drawn     = render.drawn;
+	m_instances = render.instances;
+	m_rejected  = render.rejected;
+	m_accepted  = render.accepted;
+}
+
+void FrameStats::snapshot( FILE* file ) const
+{
+	fprintf( file, "frames %lu\n", m_frames );
+	fprintf( file, "edges %lu\n",  m_edges );
+	fprintf( file, "drawn %lu\n",  m_drawn );
+	fprintf( file, "culled %lu\n", culled() );
+	fprintf( file, "instances %lu\n", m_instances );
+	fprintf( file, "instances.rejected %lu\n", m_rejected );
+	fprintf( file, "instances.accepted %lu\n", m_accepted );
+
+	for ( int s = 0; s < STAGES; s += 1 )
+	{
+		const RollingHistogram& h = m_stages[s];
+		const char*             n = name( (Stage)s );
+
+		fprintf( file, "%s.ms.last %.4f\n", n, h.last() );
+		fprintf( file, "%s.ms.mean %.4f\n", n, h.mean() );
+		fprintf( file, "%s.ms.p50 %.4f\n",  n, h.percentile(50) );
+		fprintf( file, "%s.ms.p90 %.4f\n",  n, h.percentile(90) );
+		fprintf( file, "%s.ms.p99 %.4f\n",  n, h.percentile(99) );
+		fprintf( file, "%s.ms.max %.4f\n",  n, h.max() );
+	}
+	fflush( file );
+}
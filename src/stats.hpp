@@ -0,0 +1,151 @@
+#ifndef CS488_STATS_HPP
+#define CS488_STATS_HPP
+
+#include <stddef.h>
+#include <stdio.h>
+#include <chrono>
+
+
+// Frame timing: where the time of each frame goes, kept cheap enough to
+// leave on all the time.
+
+// Monotonic time in nanoseconds, for differences
+inline double stats_now_ns()
+{
+	return std::chrono::duration<double, std::nano>(
+	       std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Where the time of one render of the scene went (see render_scene). The
+// stage times are summed over the workers, so with several of them they
+// can add up to more than the wall time.
+struct RenderStats {
+	// Culling instances, and transforming the vertices of the rest into
+	// batches
+	double        transform_ns;
+	// Projecting the vertices of batches and clipping their edges
+	double        clip_ns;
+	// Appending the workers' lines to the output, in order
+	double        merge_ns;
+	// The render from start to finish
+	double        wall_ns;
+	// Edges in the instances drawn or culled, and lines left of them
+	unsigned long edges;
+	unsigned long drawn;
+	// Instances tested against the view volume, those culled whole and
+	// those drawn without clipping
+	unsigned long instances;
+	unsigned long rejected;
+	unsigned long accepted;
+};
+
+// Adds the times and counts of "b" to "a", keeping a's wall time
+void add_stats( RenderStats& a, const RenderStats& b );
+
+// The distribution of the last WINDOW values added, in log-spaced
+// buckets: eight per doubling from MIN up, so a percentile read from them
+// is within 9% of the true one. Adding is O(1), amortized: the oldest
+// value drops out of its bucket as a new one comes in, and the max is
+// kept up to date as they do.
+class RollingHistogram {
+public:
+	enum {
+		WINDOW  = 256,
+		BUCKETS = 8 * 24 + 1
+	};
+	// Lower edge of bucket 1; bucket 0 holds everything below it
+	static const double MIN;
+
+	RollingHistogram();
+
+	void   add       ( double value );
+	void   clear     ();
+
+	// Values in the window
+	size_t count     () const { return m_count; }
+	double last      () const;
+	double mean      () const;
+	double max       () const;
+
+	// The upper edge of the bucket holding the pct'th percentile of the
+	// window, 0 if it is empty
+	double percentile( double pct ) const;
+
+	// Bucket b holds the values in [lower( b ), lower( b + 1 ))
+	size_t bucket    ( size_t b ) const { return m_buckets[b]; }
+	static double lower( size_t b );
+
+private:
+	static size_t bucket_of( double value );
+
+	double m_values [WINDOW];
+	size_t m_buckets[BUCKETS];
+	size_t m_next;
+	size_t m_count;
+	double m_sum;
+
+	// Where in m_values the values that may still become the max are, in
+	// the order they were added and so decreasing. The first is the max;
+	// each drops out when it leaves the window, or when a value at least
+	// as big comes after it.
+	size_t m_maxAt  [WINDOW];
+	size_t m_maxFirst;
+	size_t m_maxCount;
+};
+
+// The viewer's frames over the last RollingHistogram::WINDOW of them:
+// a histogram of the time in milliseconds of each stage, and the edge
+// counts of the last one
+class FrameStats {
+public:
+	enum Stage {
+		TRANSFORM,
+		CLIP,
+		MERGE,
+		SUBMIT,
+		SWAP,
+		FRAME,
+		STAGES
+	};
+
+	FrameStats();
+
+	// Adds a frame: the render of its lines, and the times taken to
+	// submit them for drawing, swap buffers and draw the whole frame
+	void   add    ( const RenderStats& render, double submit_ns,
+	                double swap_ns, double frame_ns );
+	void   clear  ();
+
+	const RollingHistogram& stage( Stage stage ) const
+	{
+		return m_stages[stage];
+	}
+	static const char*      name ( Stage stage );
+
+	// Frames added since the last clear
+	unsigned long frames () const { return m_frames; }
+	// Edges clipped in the last frame, and those drawn or culled
+	unsigned long edges  () const { return m_edges; }
+	unsigned long drawn  () const { return m_drawn; }
+	unsigned long culled () const { return m_edges - m_drawn; }
+	// Instances in the last frame, and those culled whole or drawn
+	// without clipping
+	unsigned long instances() const { return m_instances; }
+	unsigned long rejected () const { return m_rejected; }
+	unsigned long accepted () const { return m_accepted; }
+
+	// Writes every counter as a "name value" line, such as
+	// "transform.ms.p99 0.25", for tools to pick up
+	void   snapshot( FILE* file ) const;
+
+private:
+	RollingHistogram m_stages[STAGES];
+	unsigned long    m_frames;
+	unsigned long    m_edges;
+	unsigned long    m_drawn;
+	unsigned long    m_instances;
+	unsigned long    m_rejected;
+	unsigned long    m_accepted;
+};
+
+#endif
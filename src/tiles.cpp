@@ -0,0 +1,122 @@
+#include "tiles.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+
+// How far from the line, in pixels, line_aa may touch a pixel. Half a
+// pixel to the centres, one more for the second pixel of each pair, and
+// some room for the fixed-point rounding.
+static const double REACH = 2.0;
+
+TiledRaster::TiledRaster()
+	: m_width  ( 0 )
+	, m_height ( 0 )
+	, m_columns( 0 )
+	, m_rows   ( 0 )
+	, m_binned ( 0 )
+{
+}
+
+void TiledRaster::begin( int width, int height )
+{
+	m_width   = std::max( 0, width );
+	m_height  = std::max( 0, height );
+	m_columns = ( m_width  + TILE - 1 ) / TILE;
+	m_rows    = ( m_height + TILE - 1 ) / TILE;
+	m_binned  = 0;
+
+	m_lines.clear();
+
+	// Keep the bins' storage from frame to frame
+	m_bins.resize( (size_t)m_columns * m_rows );
+	for ( size_t i = 0; i < m_bins.size(); i += 1 )
+	{
+		m_bins[i].clear();
+	}
+}
+
+// The tile index of coordinate c, clamped to [0, count)
+static int tile_of( double c, int count )
+{
+	double t = floor( c / TiledRaster::TILE );
+	return (int)std::min( (double)count - 1, std::max( 0.0, t ) );
+}
+
+void TiledRaster::add( const Point2D& p, const Point2D& q, uint32_t pixel )
+{
+	double xmin = std::min( p[0], q[0] ), xmax = std::max( p[0], q[0] );
+	double ymin = std::min( p[1], q[1] ), ymax = std::max( p[1], q[1] );
+
+	if ( xmax < -REACH || xmin > m_width  + REACH ||
+	     ymax < -REACH || ymin > m_height + REACH )
+	{
+		return;
+	}
+
+	uint32_t index = (uint32_t)m_lines.size();
+	Line     line  = { p, q, pixel };
+	m_lines.push_back( line );
+
+	// For each row of tiles, the tiles across the part of the line within
+	// reach of that row
+	double dx = q[0] - p[0], dy = q[1] - p[1];
+	int    r0 = tile_of( ymin - REACH, m_rows );
+	int    r1 = tile_of( ymax + REACH, m_rows );
+
+	for ( int r = r0; r <= r1; r += 1 )
+	{
+		double xa = xmin, xb = xmax;
+
+		if ( dy != 0.0 )
+		{
+			double t0 = ( r * TILE - REACH - p[1] ) / dy;
+			double t1 = ( ( r + 1 ) * TILE + REACH - p[1] ) / dy;
+			if ( t0 > t1 )
+			{
+				std::swap( t0, t1 );
+			}
+			t0 = std::max( 0.0, t0 );
+			t1 = std::min( 1.0, t1 );
+
+			xa = p[0] + t0 * dx;
+			xb = p[0] + t1 * dx;
+			if ( xa > xb )
+			{
+				std::swap( xa, xb );
+			}
+		}
+
+		int c0 = tile_of( xa - REACH, m_columns );
+		int c1 = tile_of( xb + REACH, m_columns );
+		for ( int c = c0; c <= c1; c += 1 )
+		{
+			m_bins[r * m_columns + c].push_back( index );
+		}
+		m_binned += c1 - c0 + 1;
+	}
+}
+
+void TiledRaster::render( Framebuffer& frame, uint32_t background,
+                          Scheduler& scheduler ) const
+{
+	frame.resize( m_width, m_height );
+
+	scheduler.run( m_bins.size(), [&]( size_t t, size_t )
+	{
+		int left   = (int)( t % m_columns ) * TILE;
+		int top    = (int)( t / m_columns ) * TILE;
+		int right  = std::min( m_width,  left + (int)TILE );
+		int bottom = std::min( m_height, top  + (int)TILE );
+
+		frame.clear( background, left, top, right, bottom );
+
+		const std::vector<uint32_t>& bin = m_bins[t];
+		for ( size_t i = 0; i < bin.size(); i += 1 )
+		{
+			const Line& line = m_lines[bin[i]];
+			frame.line_aa( line.p, line.q, line.pixel,
+			               left, top, right, bottom );
+		}
+	} );
+}
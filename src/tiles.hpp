@@ -0,0 +1,59 @@
+#ifndef CS488_TILES_HPP
+#define CS488_TILES_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "raster.hpp"
+#include "scheduler.hpp"
+
+
+// Anti-aliased line drawing for a whole frame at once, spread over the
+// workers of a Scheduler. Lines are collected first, each binned into the
+// square tiles of the framebuffer it may touch; then every tile is a task
+// that clears its pixels and draws its lines, clipped to the tile, in the
+// order they were added. Tiles share no pixels, so the workers need no
+// locking, and the frame is exactly what Framebuffer::line_aa would draw
+// line by line on one thread.
+class TiledRaster {
+public:
+	// Tile edge length in pixels
+	enum { TILE = 64 };
+
+	TiledRaster();
+
+	// Starts a frame of width x height pixels, dropping all lines
+	void   begin  ( int width, int height );
+
+	// Adds a line between p and q in window coordinates, in colour "pixel"
+	// (see Framebuffer::pack)
+	void   add    ( const Point2D& p, const Point2D& q, uint32_t pixel );
+
+	// Clears "frame" to "background" and draws the lines into it, resizing
+	// it to the size given to begin
+	void   render ( Framebuffer& frame, uint32_t background,
+	                Scheduler& scheduler ) const;
+
+	size_t lines  () const { return m_lines.size(); }
+	size_t tiles  () const { return m_bins.size(); }
+	// Line and tile pairs binned, at least one per line on the frame
+	size_t binned () const { return m_binned; }
+
+private:
+	struct Line {
+		Point2D  p;
+		Point2D  q;
+		uint32_t pixel;
+	};
+
+	int                                  m_width;
+	int                                  m_height;
+	int                                  m_columns;
+	int                                  m_rows;
+	std::vector<Line>                    m_lines;
+	// Indices into m_lines of the lines each tile may touch, row by row
+	std::vector< std::vector<uint32_t> > m_bins;
+	size_t                               m_binned;
+};
+
+#endif
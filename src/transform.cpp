@@ -0,0 +1,86 @@
+#include "transform.hpp"
+
+
+void transform_points( const Matrix4x4f& m,
+                       const float* xs, const float* ys, const float* zs,
+                       size_t n, float* ox, float* oy, float* oz )
+{
+	size_t i = 0;
+
+#if defined(__AVX__)
+	// Eight points at a time, with every matrix element broadcast
+	__m256 m00 = _mm256_set1_ps( m(0, 0) ), m01 = _mm256_set1_ps( m(0, 1) ),
+	       m02 = _mm256_set1_ps( m(0, 2) ), m03 = _mm256_set1_ps( m(0, 3) );
+	__m256 m10 = _mm256_set1_ps( m(1, 0) ), m11 = _mm256_set1_ps( m(1, 1) ),
+	       m12 = _mm256_set1_ps( m(1, 2) ), m13 = _mm256_set1_ps( m(1, 3) );
+	__m256 m20 = _mm256_set1_ps( m(2, 0) ), m21 = _mm256_set1_ps( m(2, 1) ),
+	       m22 = _mm256_set1_ps( m(2, 2) ), m23 = _mm256_set1_ps( m(2, 3) );
+
+	for ( ; i + 8 <= n; i += 8 )
+	{
+		__m256 x = _mm256_loadu_ps( xs + i );
+		__m256 y = _mm256_loadu_ps( ys + i );
+		__m256 z = _mm256_loadu_ps( zs + i );
+
+		__m256 rx = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(m00, x),
+		                                         _mm256_mul_ps(m01, y)),
+		                           _mm256_add_ps(_mm256_mul_ps(m02, z), m03) );
+		__m256 ry = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(m10, x),
+		                                         _mm256_mul_ps(m11, y)),
+		                           _mm256_add_ps(_mm256_mul_ps(m12, z), m13) );
+		__m256 rz = _mm256_add_ps( _mm256_add_ps(_mm256_mul_ps(m20, x),
+		                                         _mm256_mul_ps(m21, y)),
+		                           _mm256_add_ps(_mm256_mul_ps(m22, z), m23) );
+
+		_mm256_storeu_ps( ox + i, rx );
+		_mm256_storeu_ps( oy + i, ry );
+		_mm256_storeu_ps( oz + i, rz );
+	}
+#elif defined(__SSE2__)
+	// Four points at a time, with every matrix element broadcast
+	__m128 m00 = _mm_set1_ps( m(0, 0) ), m01 = _mm_set1_ps( m(0, 1) ),
+	       m02 = _mm_set1_ps( m(0, 2) ), m03 = _mm_set1_ps( m(0, 3) );
+	__m128 m10 = _mm_set1_ps( m(1, 0) ), m11 = _mm_set1_ps( m(1, 1) ),
+	       m12 = _mm_set1_ps( m(1, 2) ), m13 = _mm_set1_ps( m(1, 3) );
+	__m128 m20 = _mm_set1_ps( m(2, 0) ), m21 = _mm_set1_ps( m(2, 1) ),
+	       m22 = _mm_set1_ps( m(2, 2) ), m23 = _mm_set1_ps( m(2, 3) );
+
+	for ( ; i + 4 <= n; i += 4 )
+	{
+		__m128 x = _mm_loadu_ps( xs + i );
+		__m128 y = _mm_loadu_ps( ys + i );
+		__m128 z = _mm_loadu_ps( zs + i );
+
+		__m128 rx = _mm_add_ps( _mm_add_ps(_mm_mul_ps(m00, x),
+		                                   _mm_mul_ps(m01, y)),
+		                        _mm_add_ps(_mm_mul_ps(m02, z), m03) );
+		__m128 ry = _mm_add_ps( _mm_add_ps(_mm_mul_ps(m10, x),
+		                                   _mm_mul_ps(m11, y)),
+		                        _mm_add_ps(_mm_mul_ps(m12, z), m13) );
+		__m128 rz = _mm_add_ps( _mm_add_ps(_mm_mul_ps(m20, x),
+		                                   _mm_mul_ps(m21, y)),
+		                        _mm_add_ps(_mm_mul_ps(m22, z), m23) );
+
+		_mm_storeu_ps( ox + i, rx );
+		_mm_storeu_ps( oy + i, ry );
+		_mm_storeu_ps( oz + i, rz );
+	}
+#endif
+
+	// Whatever is left over, one point at a time
+	for ( ; i < n; i += 1 )
+	{
+		float x = xs[i], y = ys[i], z = zs[i];
+
+		ox[i] = ( m(0, 0) * x + m(0, 1) * y ) + ( m(0, 2) * z + m(0, 3) );
+		oy[i] = ( m(1, 0) * x + m(1, 1) * y ) + ( m(1, 2) * z + m(1, 3) );
+		oz[i] = ( m(2, 0) * x + m(2, 1) * y ) + ( m(2, 2) * z + m(2, 3) );
+	}
+}
+
+void transform_points( const Matrix4x4& m,
+                       const float* xs, const float* ys, const float* zs,
+                       size_t n, float* ox, float* oy, float* oz )
+{
+	transform_points( Matrix4x4f(m), xs, ys, zs, n, ox, oy, oz );
+}
@@ -0,0 +1,27 @@
+#ifndef CS488_TRANSFORM_HPP
+#define CS488_TRANSFORM_HPP
+
+#include <stddef.h>
+#include "algebra.hpp"
+#include "simd.hpp"
+
+
+// Batch point transforms over structure-of-arrays buffers: the x, y and
+// z coordinates of the n points live in three separate arrays, so the
+// kernel can work on 4 (SSE) or 8 (AVX) points at a time. As with
+// Matrix4x4 * Point3D, the points are taken to have w = 1 and the bottom
+// row of the matrix is ignored. The output arrays may not overlap the
+// inputs, and need no particular alignment.
+//
+// Concatenate all the transforms of an object into one matrix first, so
+// each point costs a single matrix-point product.
+void transform_points( const Matrix4x4f& m,
+                       const float* xs, const float* ys, const float* zs,
+                       size_t n, float* ox, float* oy, float* oz );
+
+// Same as above, converting the matrix to single precision first
+void transform_points( const Matrix4x4& m,
+                       const float* xs, const float* ys, const float* zs,
+                       size_t n, float* ox, float* oy, float* oz );
+
+#endif
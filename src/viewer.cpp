@@ -1,15 +1,25 @@
 #include "viewer.hpp"
 #include "appwindow.hpp"
 #include "draw.hpp"
+#include "meshload.hpp"
 
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 #include <algorithm>
 #include <iostream>
-#include <sstream>
 #include <vector>
 
 
+// Interval of the frame tick, in milliseconds: about one refresh of a
+// 60Hz display
+static const unsigned FRAME_MS = 16;
+
+// Shortest time between changes of the infobar text, in milliseconds
+static const double INFOBAR_MS = 100.0;
+
 Viewer::Viewer()
 {
 	Glib::RefPtr<Gdk::GL::Config> glconfig;
@@ -41,12 +51,22 @@ Viewer::Viewer()
 				Gdk::POINTER_MOTION_MASK	|
 				Gdk::VISIBILITY_NOTIFY_MASK );
 
-	m_initflag = true;
+	// Software frames are rasterized on the workers that render the scene
+	draw_set_scheduler( &m_pipeline.scheduler() );
+
+	m_showStats    = false;
+	m_infoText[0]  = '\0';
+	m_infoShown[0] = '\0';
+	m_infoTime     = 0.0;
+	m_initflag     = true;
 	reset();
 }
 
 Viewer::~Viewer()
 {
+	m_tick.disconnect();
+	m_infoTick.disconnect();
+	draw_set_scheduler( NULL );
 }
 
 void Viewer::set_mode( Mode mode )
@@ -70,24 +90,8 @@ void Viewer::invalidate()
 void Viewer::set_perspective( double fov,  double aspect,
                               double near, double far )
 {
-	Vector4D row1, row2, row3, row4;
-	double   rfov, x1, x2;
-
-	// Error check
-	if      ( fov < 5   ) fov = 5;
-	else if ( fov > 160 ) fov = 160;
-
-	// Calculate the fov in degrees related to the viewport
-	rfov = 1 / tan( fov * PI / 360 );
-	x1   = (      far + near ) / ( far - near );
-	x2   = ( -2 * far * near ) / ( far - near );
-
-	// Implement perspective matrix as described in course notes
-	row1         = Vector4D( rfov / aspect, 0,    0,  0  );
-	row2         = Vector4D( 0,             rfov, 0,  0  );
-	row3         = Vector4D( 0,             0,    x1, x2 );
-	row4         = Vector4D( 0,             0,    1,  0  );
-	m_projection = Matrix4x4( row1, row2, row3, row4 );
+	m_motion.apply( m_pipeline );
+	m_pipeline.set_perspective( fov, aspect, near, far );
 }
 
 void Viewer::reset_view()
@@ -95,6 +99,108 @@ void Viewer::reset_view()
 	reset();
 }
 
+void Viewer::set_cubes( int cubes )
+{
+	m_pipeline.set_cubes( cubes );
+	m_viewflag = false;
+	invalidate();
+}
+
+bool Viewer::open_mesh( const char* filename )
+{
+	Mesh          mesh;
+	MeshLoadStats stats;
+	std::string   error;
+	if ( !load_mesh(filename, mesh, Colour(1.0, 1.0, 1.0),
+	                m_pipeline.scheduler(), error, &stats) )
+	{
+		std::cerr << error << std::endl;
+		return false;
+	}
+	stats.report( stderr, filename );
+
+	fit_mesh( mesh );
+	m_pipeline.set_mesh( mesh );
+	m_viewflag = false;
+	invalidate();
+
+	return true;
+}
+
+bool Viewer::open_scene( const char* filename )
+{
+	// The pipeline mustn't be left pointing into the old file once it is
+	// closed, whether the new one opens or not
+	m_pipeline.set_scene_file( NULL );
+
+	std::string error;
+	double      start = stats_now_ns();
+	if ( !m_sceneFile.open(filename, error) )
+	{
+		std::cerr << error << std::endl;
+		return false;
+	}
+	fprintf( stderr, "%s: %.1f MB opened in %.3f ms\n", filename,
+	         m_sceneFile.bytes() * 1e-6, ( stats_now_ns() - start ) * 1e-6 );
+
+	m_pipeline.set_scene_file( &m_sceneFile );
+	m_viewflag = false;
+	invalidate();
+
+	return true;
+}
+
+void Viewer::toggle_stats()
+{
+	m_showStats = !m_showStats;
+	update_infobar();
+}
+
+void Viewer::dump_stats()
+{
+	m_stats.snapshot( stdout );
+}
+
+bool Viewer::record( const char* filename )
+{
+	std::string error;
+	if ( !m_recorder.open(filename, error) )
+	{
+		std::cerr << error << std::endl;
+		return false;
+	}
+
+	m_motion.discard();
+	m_pipeline.set_recorder( &m_recorder );
+	m_viewflag = false;
+
+	return true;
+}
+
+void Viewer::select_all()
+{
+	// Movement so far goes to the old selection
+	m_motion.apply( m_pipeline );
+	m_pipeline.select_all();
+	invalidate();
+}
+
+void Viewer::select_next()
+{
+	// Movement so far goes to the old selection
+	m_motion.apply( m_pipeline );
+	m_pipeline.select_next();
+	invalidate();
+}
+
+void Viewer::select_previous()
+{
+	// Movement so far goes to the old selection
+	m_motion.apply( m_pipeline );
+	m_pipeline.select_previous();
+	invalidate();
+}
+
 void Viewer::set_infobar( Gtk::Label* infobar )
 {
 	m_infobar = infobar;
@@ -135,56 +241,56 @@ bool Viewer::on_expose_event( GdkEventExpose* /*event*/ )
 		return false;
 	}
 
-	// Start drawing
-	draw_init( get_width(), get_height() );
+	double start = stats_now_ns();
 
-	// Transform the world gnomon
-	for( int i = 0; i < 4; i += 1 )
+	// Initialize the viewport
+	if ( !m_viewflag )
 	{
-		m_gnomonTrans[i] = m_viewing * m_gnomon[i];
+		m_pipeline.set_viewport( get_width()  * 0.05, get_height() * 0.05,
+		                         get_width()  * 0.95, get_height() * 0.95 );
+		m_viewflag = true;
 	}
-	// Draw the world gnomon
-	set_colour( Colour(0.1, 0.1, 1.0) );
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[1] );
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[2] );
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[3] );
 
-	// Draw the modelling gnomon
-	set_colour( Colour(0.1, 1.0, 0.1) );
-	draw_modellingGnomon();
+	// Catch up with the mouse, then run the scene through the pipeline.
+	// If nothing changed since the last expose this is the same list of
+	// lines as then.
+	m_motion.apply( m_pipeline );
+	const LineList& lines = m_pipeline.frame();
 
-	// Draw the unit cube
-	set_colour( Colour(0.1, 0.1, 0.1) );
-	draw_unitCube();
+	// Start drawing
+	double submit = stats_now_ns();
+	draw_init( get_width(), get_height() );
 
-	// Initialize the viewport
-	if ( !m_viewflag )
+	// Draw the lines, changing colour only when needed
+	size_t colour = (size_t)-1;
+	for ( size_t i = 0; i < lines.size(); i += 1 )
 	{
-		m_viewport[0] = ( Point2D(get_width() * 0.05, get_height() * 0.05) );
-		m_viewport[1] = ( Point2D(get_width() * 0.95, get_height() * 0.05) );
-		m_viewport[2] = ( Point2D(get_width() * 0.95, get_height() * 0.95) );
-		m_viewport[3] = ( Point2D(get_width() * 0.05, get_height() * 0.95) );
-		m_viewflag    = true;
+		const LineList::Line& line = lines[i];
+		if ( line.colour != colour )
+		{
+			colour = line.colour;
+			set_colour( lines.colour(colour) );
+		}
+		draw_line( line.p, line.q );
 	}
-	// Draw the viewport
-	set_colour( Colour(0.1, 0.1, 0.1) );
-	draw_line( m_viewport[0], m_viewport[1] );
-	draw_line( m_viewport[1], m_viewport[2] );
-	draw_line( m_viewport[2], m_viewport[3] );
-	draw_line( m_viewport[3], m_viewport[0] );
 
 	// Finish drawing
 	draw_complete();
 
-	// Update the information bar
-	update_infobar();
-
 	// Swap the contents of the front and back buffers so we see what we
 	// just drew. This should only be done if double buffering is enabled.
+	double swap = stats_now_ns();
 	gldrawable->swap_buffers();
 
 	gldrawable->gl_end();
 
+	double end = stats_now_ns();
+	m_stats.add( m_pipeline.frame_stats(), swap - submit, end - swap,
+	             end - start );
+
+	// Update the information bar
+	update_infobar();
+
 	return true;
 }
 
@@ -241,6 +347,12 @@ bool Viewer::on_button_press_event( GdkEventButton* event )
 
 bool Viewer::on_button_release_event( GdkEventButton* event )
 {
+	// Movement so far was made with the buttons still down
+	if ( m_motion.apply(m_pipeline) )
+	{
+		invalidate();
+	}
+
 	if ( m_mode == VIEWPORT && m_button1 )
 	{
 		m_xpos = event->x;
@@ -264,10 +376,7 @@ bool Viewer::on_button_release_event( GdkEventButton* event )
 		y2 = std::max( m_iypos, m_ypos );
 
 		// Update viewport
-		m_viewport[0] = ( Point2D(x1, y1) );
-		m_viewport[1] = ( Point2D(x2, y1) );
-		m_viewport[2] = ( Point2D(x2, y2) );
-		m_viewport[3] = ( Point2D(x1, y2) );
+		m_pipeline.set_viewport( x1, y1, x2, y2 );
 
 		invalidate();
 	}
@@ -298,118 +407,30 @@ bool Viewer::on_motion_notify_event( GdkEventMotion* event )
 		m_txpos = m_xpos;
 		m_xpos  = event->x;
 
-		switch ( m_mode )
+		// Pipeline::Mode follows the order of Viewer::Mode. The movement is
+		// only queued; the next frame tick shows it, along with whatever
+		// else arrives before then.
+		m_motion.add( m_pipeline, (Pipeline::Mode)m_mode,
+		              m_button1, m_button2, m_button3, m_txpos - m_xpos );
+
+		if ( !m_tick.connected() )
 		{
-		case VIEWROTATE:
-			if ( m_button1 )
-			{
-				m_viewing = m_viewing *
-						rotation( (m_txpos - m_xpos) / 100.0, 'y' ).invert();
-			}
-			if ( m_button2 )
-			{
-				m_viewing = m_viewing *
-						rotation( (m_txpos - m_xpos) / 100.0, 'z' ).invert();
-			}
-			if ( m_button3 )
-			{
-				m_viewing = m_viewing *
-						rotation( (m_txpos - m_xpos) / 100.0, 'x' ).invert();
-			}
-			break;
-		case VIEWTRANSLATE:
-			if ( m_button1 )
-			{
-				m_viewing = translation( Vector3D(( m_txpos - m_xpos ) /
-						100.0, 0.0, 0.0) ).invert() * m_viewing;
-			}
-			if ( m_button2 )
-			{
-				m_viewing = translation( Vector3D(0.0, ( m_txpos - m_xpos ) /
-						100.0, 0.0) ).invert() * m_viewing;
-			}
-			if ( m_button3 )
-			{
-				m_viewing = translation( Vector3D(0.0, 0.0,
-						( m_txpos - m_xpos ) / 100.0) ).invert() * m_viewing;
-			}
-			break;
-		case VIEWPERSPECTIVE:
-			if ( m_button1 )
-			{
-				m_fov  -= ( m_txpos - m_xpos ) / 10.0;
-				set_perspective( m_fov, 1, m_near, m_far );
-			}
-			if ( m_button2 )
-			{
-				m_near -= ( m_txpos - m_xpos ) / 10.0;
-			}
-			if ( m_button3 )
-			{
-				m_far  -= ( m_txpos - m_xpos ) / 10.0;
-			}
-			break;
-		case MODELROTATE:
-			if ( m_button1 )
-			{
-				m_modelling = m_modelling *
-						rotation( (m_txpos - m_xpos) / 100.0, 'y' ).invert();
-			}
-			if ( m_button2 )
-			{
-				m_modelling = m_modelling *
-						rotation( (m_txpos - m_xpos) / 100.0, 'z' ).invert();
-			}
-			if ( m_button3 )
-			{
-				m_modelling = m_modelling *
-						rotation( (m_txpos - m_xpos) / 100.0, 'x' ).invert();
-			}
-			break;
-		case MODELTRANSLATE:
-			if ( m_button1 )
-			{
-				m_modelling = m_modelling * translation( Vector3D
-						(( m_txpos - m_xpos ) / -100.0, 0.0, 0.0) );
-			}
-			if ( m_button2 )
-			{
-				m_modelling = m_modelling * translation( Vector3D
-						(0.0, ( m_txpos - m_xpos ) / -100.0, 0.0) );
-			}
-			if ( m_button3 )
-			{
-				m_modelling = m_modelling * translation( Vector3D
-						(0.0, 0.0, ( m_txpos - m_xpos ) / -100.0) );
-			}
-			break;
-		case MODELSCALE:
-			if ( m_button1 )
-			{
-				m_scaling = m_scaling * scaling( Vector3D(1.0 +
-						( (m_txpos - m_xpos) / 100.0 ), 1.0, 1.0) ).invert();
-			}
-			if ( m_button2 )
-			{
-				m_scaling = m_scaling * scaling( Vector3D(1.0, 1.0 +
-						( m_txpos - m_xpos ) / 100.0, 1.0) ).invert();
-			}
-			if ( m_button3 )
-			{
-				m_scaling = m_scaling * scaling( Vector3D(1.0, 1.0, 1.0 +
-						( m_txpos - m_xpos ) / 100.0) ).invert();
-			}
-			break;
-		default:
-			break;
+			m_tick = Glib::signal_timeout().connect(
+				sigc::mem_fun(*this, &Viewer::on_frame_tick), FRAME_MS );
 		}
-
-		invalidate();
 	}
 
 	return true;
 }
 
+bool Viewer::on_frame_tick()
+{
+	// The movement is applied in on_expose_event, so that any redraw
+	// picks it up. Returning false stops the timer until the next one.
+	invalidate();
+	return false;
+}
+
 void Viewer::reset()
 {
 	if ( !m_initflag )
@@ -427,313 +448,148 @@ void Viewer::reset()
 	m_ypos    = 0.0;
 	m_txpos   = 0.0;
 
-	// Initialize viewport
-	for ( int i = 0; i < 4; i += 1 )
-	{
-		m_viewport[i] = ( Point2D() );
-	}
-
-	// Default FOV of 30
-	m_fov  = 30.0;
-
-	// Set the default far and near plane values
-	m_near = 2.0;
-	m_far  = 20.0;
-
-	// Initialize all the transformation matrices
-	m_projection = Matrix4x4();
-	m_modelling  = Matrix4x4();
-	m_viewing    = Matrix4x4();
-	m_scaling    = Matrix4x4();
-	// Start off by pushing the cube back into the screen
-	Vector4D row1, row2, row3, row4;
-	row1      = Vector4D( 1,   0,  0, 0 );
-	row2      = Vector4D( 0,   1,  0, 0 );
-	row3      = Vector4D( 0,   0,  1, 8 );
-	row4      = Vector4D( 0,   0,  0, 1 );
-	m_viewing = Matrix4x4( row1, row2, row3, row4 );
-
-	// Initialize the unit cubes
-	m_unitCube[0] = ( Point3D( 1.0, -1.0, -1.0) );
-	m_unitCube[1] = ( Point3D(-1.0, -1.0, -1.0) );
-	m_unitCube[2] = ( Point3D(-1.0,  1.0, -1.0) );
-	m_unitCube[3] = ( Point3D( 1.0,  1.0, -1.0) );
-	m_unitCube[4] = ( Point3D(-1.0, -1.0,  1.0) );
-	m_unitCube[5] = ( Point3D( 1.0, -1.0,  1.0) );
-	m_unitCube[6] = ( Point3D( 1.0,  1.0,  1.0) );
-	m_unitCube[7] = ( Point3D(-1.0,  1.0,  1.0) );
-	for ( int i = 0; i < 8; i += 1 )
-	{
-		m_unitCubeTrans[i] = ( Point3D() );
-	}
-
-	// Initialize the gnomons
-	m_gnomon[0] = ( Point3D(0.0, 0.0, 0.0) );
-	m_gnomon[1] = ( Point3D(0.5, 0.0, 0.0) );
-	m_gnomon[2] = ( Point3D(0.0, 0.5, 0.0) );
-	m_gnomon[3] = ( Point3D(0.0, 0.0, 0.5) );
-	for ( int i = 0; i < 4; i += 1 )
-	{
-		m_gnomonTrans[i] = ( Point3D() );
-	}
+	// Restore the camera and transforms; the viewport gets initialized
+	// from the window size on the next expose
+	m_motion.discard();
+	m_pipeline.reset();
 
 	m_viewflag = false;
 	m_initflag = false;
-
-	// Initialize the perspective
-	set_perspective( m_fov, 1, m_near, m_far );
 }
 
-void Viewer::draw_unitCube()
+void Viewer::update_mode( Mode mode )
 {
-	// Apply transformations to unit cube
-	for( int i = 0; i < 8; i += 1 )
+	// Update both the mode and the radio button, if required
+	if ( m_mode != mode )
 	{
-		m_unitCubeTrans[i] = m_viewing   *
-							 m_modelling *
-							 m_scaling   *
-							 m_unitCube[i];
+		m_mode = mode;
+		m_window->update_mode( (int)mode );
 	}
 
-	// Draw front face of cube in white, and the rest in a dark grey
-	set_colour( Colour(1, 1, 1) );
-	draw_line2D( m_unitCubeTrans[0], m_unitCubeTrans[1] );
-	draw_line2D( m_unitCubeTrans[0], m_unitCubeTrans[3] );
-	set_colour( Colour(0.1, 0.1, 0.1) );
-	draw_line2D( m_unitCubeTrans[0], m_unitCubeTrans[5] );
-	set_colour( Colour(1, 1, 1) );
-	draw_line2D( m_unitCubeTrans[1], m_unitCubeTrans[2] );
-	set_colour( Colour(0.1, 0.1, 0.1) );
-	draw_line2D( m_unitCubeTrans[1], m_unitCubeTrans[4] );
-	set_colour( Colour(1, 1, 1) );
-	draw_line2D( m_unitCubeTrans[2], m_unitCubeTrans[3] );
-	set_colour( Colour(0.1, 0.1, 0.1) );
-	draw_line2D( m_unitCubeTrans[2], m_unitCubeTrans[7] );
-	draw_line2D( m_unitCubeTrans[3], m_unitCubeTrans[6] );
-	draw_line2D( m_unitCubeTrans[4], m_unitCubeTrans[5] );
-	draw_line2D( m_unitCubeTrans[4], m_unitCubeTrans[7] );
-	draw_line2D( m_unitCubeTrans[5], m_unitCubeTrans[6] );
-	draw_line2D( m_unitCubeTrans[6], m_unitCubeTrans[7] );
-	set_colour( Colour(0.1, 0.1, 0.1) );
+	invalidate();
 }
 
-void Viewer::draw_modellingGnomon()
+// Appends printf-style text to the "size" byte buffer "text", which holds
+// "length" characters, stopping short of its end
+static void info_append( char* text, size_t size, size_t& length,
+                         const char* format, ... )
 {
-	// Apply transformation to the modelling gnomon
-	for( int i = 0; i < 4; i += 1 )
+	va_list args;
+	va_start( args, format );
+	int written = vsnprintf( text + length, size - length, format, args );
+	va_end( args );
+
+	if ( written > 0 )
 	{
-		m_gnomonTrans[i] = m_viewing * m_modelling * m_gnomon[i];
+		length = std::min( size - 1, length + (size_t)written );
 	}
-
-	// Draw the modelling gnomon
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[1] );
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[2] );
-	draw_line2D( m_gnomonTrans[0], m_gnomonTrans[3] );
 }
 
-void Viewer::draw_line2D ( Point3D left, Point3D right )
+void Viewer::format_infobar()
 {
-	// Flag set to determine whether we draw this line
-	// Gets set to false if it lies outside the clipping area
-	bool draw = true;
-
-	// Clip to the near plane using algorithm described in course notes
-	double clipNL = ( left  - Point3D(0.0, 0.0, m_near) ).dot(
-			Vector3D(0.0, 0.0, 1.0) );
-	double clipNR = ( right - Point3D(0.0, 0.0, m_near) ).dot(
-			Vector3D(0.0, 0.0, 1.0) );
-	if ( clipNL < 0.0 && clipNR < 0.0 )
-	{
-		draw = false;
-	}
-	else
-	{
-		if ( clipNL < 0.0 || clipNR < 0.0 )
-		{
-			double t = clipNL / ( clipNL - clipNR );
-			if ( clipNL < 0.0 )
-			{
-				left = left + t * ( right - left );
-			}
-			else
-			{
-				right = left + t * ( right - left );
-			}
-		}
-	}
-
-	// Clip to the far plane using algorithm described in course notes
-	if ( draw )
+	static const char* modes[] = {
+		"View Rotate", "View Translate", "View Perspective",
+		"Model Rotate", "Model Translate", "Model Scale", "Viewport"
+	};
+
+	char*  text   = m_infoText;
+	size_t size   = sizeof( m_infoText );
+	size_t length = 0;
+
+	text[0] = '\0';
+	info_append( text, size, length, "Mode: %s, Near: %g, Far: %g",
+	             ( m_mode >= VIEWROTATE && m_mode <= VIEWPORT ) ? modes[m_mode]
+	                                                             : "",
+	             m_pipeline.view().near, m_pipeline.view().far );
+
+	// Only mention the selection when there is a choice
+	size_t instances = m_pipeline.scene().instance_count();
+	if ( instances > 1 )
 	{
-		double clipFL = ( left  - Point3D(0.0, 0.0, m_far) ).dot(
-				Vector3D(0.0, 0.0, -1.0) );
-		double clipFR = ( right - Point3D(0.0, 0.0, m_far) ).dot(
-				Vector3D(0.0, 0.0, -1.0) );
-		if ( clipFL < 0.0 && clipFR < 0.0 )
+		if ( m_pipeline.selection_count() == instances )
 		{
-			draw = false;
+			info_append( text, size, length, ", Selected: all %lu",
+			             (unsigned long)instances );
 		}
 		else
 		{
-			if ( clipFL < 0.0 || clipFR < 0.0 )
-			{
-				double t = clipFL / ( clipFL - clipFR );
-				if ( clipFL < 0.0 )
-				{
-					left = left + t * ( right - left );
-				}
-				else
-				{
-					right = left + t * ( right - left );
-				}
-			}
+			info_append( text, size, length, ", Selected: %lu of %lu",
+			             (unsigned long)m_pipeline.selection_first() + 1,
+			             (unsigned long)instances );
 		}
 	}
 
-	// Now transform and clip to the viewport
-	if( draw )
+	// Mouse events folded into others rather than drawn on their own
+	if ( m_motion.merged() > 0 )
 	{
-		// First we project, then normalize each of the points
-		Point2D nleft  = normalize( project(left)  );
-		Point2D nright = normalize( project(right) );
+		info_append( text, size, length, ", Merged events: %lu",
+		             m_motion.merged() );
+	}
 
-		// Next, we clip to the viewing cube (the viewport) using algorithm
-		// described in course notes
-		for ( int i = 0; i < 4; i++ )
-		{
-			Point2D normal;
-			double clipVL, clipVR;
-			switch( i )
-			{
-			case 0:
-				clipVL = nleft[1]  - m_viewport[0][1];
-				clipVR = nright[1] - m_viewport[0][1];
-				break;
-			case 1:
-				clipVL = -1.0 * ( nleft[0]  - m_viewport[1][0] );
-				clipVR = -1.0 * ( nright[0] - m_viewport[1][0] );
-				break;
-			case 2:
-				clipVL = -1.0 * ( nleft[1]  - m_viewport[2][1] );
-				clipVR = -1.0 * ( nright[1] - m_viewport[2][1] );
-				break;
-			case 3:
-				clipVL = nleft[0]  - m_viewport[3][0];
-				clipVR = nright[0] - m_viewport[3][0];
-				break;
-			default:
-				clipVL = -1.0;
-				clipVR = -1.0;
-				break;
-			}
-
-			if ( clipVL < 0.0 && clipVR < 0.0 )
-			{
-				draw = false;
-			}
-			else
-			{
-				if ( clipVL < 0.0 || clipVR < 0.0 )
-				{
-					double t = clipVL / ( clipVL - clipVR );
-					if ( clipVL < 0.0 )
-					{
-						nleft[0]  = nleft[0] + t * ( nright[0] - nleft[0] );
-						nleft[1]  = nleft[1] + t * ( nright[1] - nleft[1] );
-					}
-					else
-					{
-						nright[0] = nleft[0] + t * ( nright[0] - nleft[0] );
-						nright[1] = nleft[1] + t * ( nright[1] - nleft[1] );
-					}
-				}
-			}
-		}
+	// Where the frame time goes, in milliseconds over the recent frames,
+	// on lines of its own
+	if ( m_showStats )
+	{
+		const RollingHistogram& frame = m_stats.stage( FrameStats::FRAME );
 
-		// Finally, draw the line
-		if ( draw )
+		info_append( text, size, length, "\nFrame: %.2f ms, p99: %.2f ms (",
+		             frame.mean(), frame.percentile(99) );
+		for ( int s = FrameStats::TRANSFORM; s < FrameStats::FRAME; s += 1 )
 		{
-			draw_line( nleft, nright );
+			FrameStats::Stage stage = (FrameStats::Stage)s;
+			info_append( text, size, length, "%s%s %.2f", s > 0 ? ", " : "",
+			             FrameStats::name(stage), m_stats.stage(stage).mean() );
 		}
+		info_append( text, size, length,
+		             ")\nEdges: %lu, Drawn: %lu, Culled: %lu\n"
+		             "Instances: %lu, Culled: %lu, Unclipped: %lu",
+		             m_stats.edges(), m_stats.drawn(), m_stats.culled(),
+		             m_stats.instances(), m_stats.rejected(),
+		             m_stats.accepted() );
 	}
 }
 
-Point3D Viewer::project( Point3D point )
+void Viewer::update_infobar( )
 {
-	// Project the point into the viewing plane using algorithm described in
-	// course notes
-	Point3D point_p = m_projection * point;
-
-	return Point3D( point_p[0] / point[2],
-					point_p[1] / point[2],
-			        point_p[2] / point[2] );
-}
+	format_infobar();
 
-Point2D Viewer::normalize( Point3D point )
-{
-	// Normalize the point to the coordinates used in the viewing window using
-	// algorithm described in course notes
-	double x, y, z;
-	x = ( point[0] + 1.0 ) / 2;
-	y = ( point[1] + 1.0 ) / 2;
-	z =   point[2];
-
-	return Point2D( (point[0] / z + 1.5) *
-			        (m_viewport[2][0] - m_viewport[0][0]) /
-			         3 + m_viewport[0][0],
-					(point[1] / z + 1.5) *
-					(m_viewport[2][1] - m_viewport[0][1]) /
-					 3 + m_viewport[0][1] );
-}
+	// GTK copies the label and lays the bar out again, so only hand it
+	// text that changed
+	if ( !strcmp(m_infoText, m_infoShown) )
+	{
+		return;
+	}
 
-void Viewer::update_mode( Mode mode )
-{
-	// Update both the mode and the radio button, if required
-	if ( m_mode != mode )
+	// Not more often than every INFOBAR_MS; a timer shows the latest text
+	// once the time is up
+	double wait = INFOBAR_MS - ( stats_now_ns() - m_infoTime ) * 1e-6;
+	if ( wait > 0.0 )
 	{
-		m_mode = mode;
-		m_window->update_mode( (int)mode );
+		if ( !m_infoTick.connected() )
+		{
+			m_infoTick = Glib::signal_timeout().connect(
+				sigc::mem_fun(*this, &Viewer::on_infobar_tick),
+				(unsigned)ceil( wait ) );
+		}
+		return;
 	}
 
-	invalidate();
+	show_infobar();
 }
 
-void Viewer::update_infobar( )
+bool Viewer::on_infobar_tick()
 {
-	std::stringstream infoss;
-	infoss << "Mode: ";
-
-	switch( m_mode )
+	format_infobar();
+	if ( strcmp(m_infoText, m_infoShown) )
 	{
-	case VIEWROTATE:
-		infoss << "View Rotate";
-		break;
-	case VIEWTRANSLATE:
-		infoss << "View Translate";
-		break;
-	case VIEWPERSPECTIVE:
-		infoss << "View Perspective";
-		break;
-	case MODELROTATE:
-		infoss << "Model Rotate";
-		break;
-	case MODELTRANSLATE:
-		infoss << "Model Translate";
-		break;
-	case MODELSCALE:
-		infoss << "Model Scale";
-		break;
-	case VIEWPORT:
-		infoss << "Viewport";
-		break;
-	default:
-		infoss << "";
-		break;
+		show_infobar();
 	}
+	return false;
+}
 
-	infoss << ", Near: " << m_near;
-	infoss << ", Far: "  << m_far;
-	infoss << std::endl;
-
-	m_infobar->set_label( infoss.str() );
+void Viewer::show_infobar()
+{
+	strcpy( m_infoShown, m_infoText );
+	m_infoTime = stats_now_ns();
+	m_infobar->set_label( m_infoShown );
 }
@@ -6,10 +6,11 @@
 #include <math.h>
 #include <vector>
 #include "algebra.hpp"
-#include "a2.hpp"
-
-// Define a default value for Pi
-#define PI 4*atan(1)
+#include "motion.hpp"
+#include "pipeline.hpp"
+#include "scenefile.hpp"
+#include "session.hpp"
+#include "stats.hpp"
 
 
 class AppWindow;
@@ -51,6 +52,37 @@ public:
 	// original state. Set the viewport to its initial size.
 	void reset_view();
 
+	// Set the number of cubes in the scene, laid out on a grid if there
+	// is more than one
+	void set_cubes( int cubes );
+
+	// Draw the wireframe in "filename", an OBJ or PLY file, in place of
+	// each cube, fitted to the cube's size. Returns false, having said why,
+	// if it can't be loaded; says how long loading took otherwise.
+	bool open_mesh( const char* filename );
+
+	// Draw the scene cache in "filename" (see scenefile.hpp) instead.
+	// Returns false, having said why, if it can't be opened, and goes back
+	// to the mesh; says how long opening took otherwise.
+	bool open_scene( const char* filename );
+
+	// Choose the cubes the modelling modes act on: all of them, or a
+	// single one following or preceding the current one
+	void select_all     ();
+	void select_next    ();
+	void select_previous();
+
+	// Show or hide the frame timings in the information bar
+	void toggle_stats   ();
+
+	// Write the frame timings to stdout, as FrameStats::snapshot does
+	void dump_stats     ();
+
+	// Record the session from here on into "filename" (see session.hpp),
+	// starting over from the original state. Returns false, having said
+	// why, if the file can't be created.
+	bool record( const char* filename );
+
 protected:
 	// Events we implement
 	// Note that we could use gtkmm's "signals and slots" mechanism
@@ -71,30 +103,25 @@ protected:
 	// Called when the mouse moves
 	virtual bool on_motion_notify_event ( GdkEventMotion*    event );
 
+	// Called once a frame while there is mouse movement to show
+	bool         on_frame_tick          ();
+
 private:
 	// Set/reset the application state
 	void    reset               ();
 
-	// Used to draw the unit cube
-	void    draw_unitCube       ();
-
-	// Used to draw the modelling gnomon
-	void    draw_modellingGnomon();
-
-	// Used to draw a 3D line in the 2D window
-	void    draw_line2D         ( Point3D left, Point3D right );
-
-	// Applies projective transform to a point
-	Point3D project             ( Point3D point               );
-
-	// Normalizes a point to the viewing window
-	Point2D normalize           ( Point3D point               );
-
 	// Updates the application mode
 	void    update_mode         ( Mode mode                   );
 
-	// Updates the information bar
+	// Updates the information bar, if its text changed and it wasn't
+	// changed too recently
 	void    update_infobar      ();
+	// Writes the text of the information bar into m_infoText
+	void    format_infobar      ();
+	// Hands m_infoText to the information bar
+	void    show_infobar        ();
+	// Called once an update held back by update_infobar is due
+	bool    on_infobar_tick     ();
 
 	// The AppWindow object
 	AppWindow*  m_window;
@@ -108,29 +135,21 @@ private:
 	double      m_xpos,    m_ypos;
 	double      m_txpos;
 
-	// Viewport corners
-	Point2D     m_viewport[4];
-
-	// FOV value, default 30
-	double      m_fov;
+	// Where the session is recorded to, if anywhere; declared before the
+	// pipeline, which logs to it, so it outlives it
+	SessionRecorder m_recorder;
 
-	// Clipping planes
-	double      m_near;
-	double      m_far;
+	// The scene cache being drawn, if any; the pipeline's scene points
+	// into it, so it is declared before that too
+	SceneFile       m_sceneFile;
 
-	// Transformation matrices
-	Matrix4x4   m_projection;
-	Matrix4x4   m_modelling;
-	Matrix4x4   m_viewing;
-	Matrix4x4   m_scaling;
+	// The camera, transforms and scene
+	Pipeline    m_pipeline;
 
-	// Stores the unit cube and the transformed unit cube
-	Point3D     m_unitCube[8];
-	Point3D     m_unitCubeTrans[8];
-
-	// Stores gnomons
-	Point3D     m_gnomon[4];
-	Point3D     m_gnomonTrans[4];
+	// Mouse movement not yet applied to the pipeline, and the timer that
+	// redraws once it has built up for a frame
+	MotionQueue      m_motion;
+	sigc::connection m_tick;
 
 	// Flags for initializing and resetting state
 	bool        m_initflag;
@@ -138,6 +157,18 @@ private:
 
 	// Pointer to the infobar
 	Gtk::Label* m_infobar;
+
+	// Timings of the recent frames, and whether the infobar shows them
+	FrameStats  m_stats;
+	bool        m_showStats;
+
+	// The infobar text, formatted in place every frame, and the text last
+	// shown, when it was shown and the timer that shows the next one
+	enum { INFO_SIZE = 512 };
+	char             m_infoText [INFO_SIZE];
+	char             m_infoShown[INFO_SIZE];
+	double           m_infoTime;
+	sigc::connection m_infoTick;
 };
 
 #endif
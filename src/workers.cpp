@@ -0,0 +1,92 @@
+#include "workers.hpp"
+
+
+WorkerPool::WorkerPool( size_t workers )
+	: m_job       ( NULL )
+	, m_pending   ( 0 )
+	, m_generation( 0 )
+	, m_quit      ( false )
+{
+	if ( workers == 0 )
+	{
+		workers = std::thread::hardware_concurrency();
+	}
+
+	for ( size_t w = 1; w < workers; w += 1 )
+	{
+		m_threads.push_back( std::thread(&WorkerPool::work, this, w) );
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_quit = true;
+	}
+	m_start.notify_all();
+
+	for ( size_t i = 0; i < m_threads.size(); i += 1 )
+	{
+		m_threads[i].join();
+	}
+}
+
+void WorkerPool::run( const std::function<void(size_t)>& job )
+{
+	if ( m_threads.empty() )
+	{
+		job( 0 );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_job        = &job;
+		m_pending    = m_threads.size();
+		m_generation += 1;
+	}
+	m_start.notify_all();
+
+	job( 0 );
+
+	std::unique_lock<std::mutex> lock( m_mutex );
+	while ( m_pending > 0 )
+	{
+		m_done.wait( lock );
+	}
+	m_job = NULL;
+}
+
+void WorkerPool::work( size_t worker )
+{
+	unsigned seen = 0;
+
+	for ( ;; )
+	{
+		const std::function<void(size_t)>* job;
+
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			while ( !m_quit && m_generation == seen )
+			{
+				m_start.wait( lock );
+			}
+			if ( m_quit )
+			{
+				return;
+			}
+			seen = m_generation;
+			job  = m_job;
+		}
+
+		( *job )( worker );
+
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_pending -= 1;
+		if ( m_pending == 0 )
+		{
+			m_done.notify_one();
+		}
+	}
+}
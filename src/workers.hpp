@@ -0,0 +1,51 @@
+#ifndef CS488_WORKERS_HPP
+#define CS488_WORKERS_HPP
+
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed set of threads that is kept around between frames, so splitting
+// the per-frame work up costs a wake-up rather than a thread start. The
+// thread calling run() takes part as worker 0.
+class WorkerPool {
+public:
+	// Starts "workers" - 1 threads; 0 picks one worker per hardware thread
+	explicit WorkerPool( size_t workers = 0 );
+	~WorkerPool();
+
+	// Number of workers, including the calling thread
+	size_t size() const { return m_threads.size() + 1; }
+
+	// Calls job( w ) once for every worker w in [0, size()), concurrently,
+	// and returns once all of them have returned. Not reentrant.
+	void   run ( const std::function<void(size_t)>& job );
+
+private:
+	WorkerPool( const WorkerPool& );
+	WorkerPool& operator=( const WorkerPool& );
+
+	// Body of thread "worker"
+	void   work( size_t worker );
+
+	std::vector<std::thread>          m_threads;
+
+	std::mutex                        m_mutex;
+	// Signalled when a job is posted, and when the last worker finishes
+	std::condition_variable           m_start;
+	std::condition_variable           m_done;
+
+	// The job being run, and how many of the threads are still on it
+	const std::function<void(size_t)>* m_job;
+	size_t                            m_pending;
+	// Bumped for every job, so threads can tell a new one from a spurious
+	// wake-up
+	unsigned                          m_generation;
+	bool                              m_quit;
+};
+
+#endif